@@ -14,6 +14,13 @@ at::Tensor DcDxHa
 (const at::Tensor & DxHa, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
 const at::Tensor & energy, const at::Tensor & states);
 
+// Block-sparse version of `DcDxHa`, where DcHd and DcDxHd are given by the blocks of each element,
+// see `UT_blocks_U` for the layout
+// return d / dc * Ha (whose diagonal is d / dc * E) and d / dc * (d / dx * H)a
+std::tuple<at::Tensor, at::Tensor> block_DcHa_DcDxHa
+(const at::Tensor & DxHa, const std::vector<at::Tensor> & DcHd_blocks, const std::vector<at::Tensor> & DcDxHd_blocks,
+const at::Tensor & energy, const at::Tensor & states);
+
 } // namespace Hderiva
 
 #endif
\ No newline at end of file
@@ -5,6 +5,31 @@
 
 namespace Hderiva {
 
+// Return A with the "lower triangle" (i > j) filled from the "upper triangle"
+// The matrix indices are the `dim`-th and (`dim` + 1)-th indices
+// symmetric: A[i][j] =  A[j][i], read the "upper triangle" (i <= j)
+// asymmetric: A[i][j] = -A[j][i], read the "strict upper triangle" (i < j)
+at::Tensor fill_lower_triangle(const at::Tensor & A, const int64_t & dim = 0, const bool & symmetric = true);
+
+// M[i][j] /= eigval[j] - eigval[i] for the "strict upper triangle" (i < j) of M,
+// other elements are untouched
+// M may have additional trailing indices, and a leading batch index if eigval is batched
+at::Tensor & divide_eigval_difference_(at::Tensor & M, const at::Tensor & eigval);
+
+// Batched version of tchem::linalg::UT_sy_U, where the 1st index of A and U is the batch index
+// Only read the "upper triangle" (i <= j) of A
+// The output tensor is fully written
+at::Tensor batch_UT_sy_U(const at::Tensor & A, const at::Tensor & U);
+
+// Block-sparse version of tchem::linalg::UT_sy_U for the parameter derivative of a symmetric matrix,
+// where each "upper triangle" element only depends on its own block of parameters:
+// blocks[l] is the derivative of element l (line by line: 00, 01, ..., 0N, 11, 12, ...)
+// over its own parameters, with the parameter index at the end
+// `blocks` may cycle through the elements several times, e.g. for a sum of networks
+// The parameters are concatenated in the order of `blocks`
+// The output tensor is fully written, with the concatenated parameter index at the end
+at::Tensor UT_blocks_U(const std::vector<at::Tensor> & blocks, const at::Tensor & U);
+
 // This routine calculates the [Ax, M] term in differentiating Ax
 // A must be a matrix or higher order tensor, with the first 2 indices as the matrix indices
 // M must be a 3rd-order tensor, with the last index as the gradient index
@@ -14,9 +39,12 @@ namespace Hderiva {
 // So the result is symmetric
 // Only read the "upper triangle" (i <= j) of A
 // Only read the "strict upper triangle" (i < j) of M
-// Only write the "upper triangle" (i <= j) of the output tensor
+// The output tensor is fully written
 at::Tensor commutor_term(const at::Tensor & A, const at::Tensor & M);
 
+// Batched version of `commutor_term`, where the 1st index of A and M is the batch index
+at::Tensor batch_commutor_term(const at::Tensor & A, const at::Tensor & M);
+
 } // namespace Hderiva
 
 #endif
\ No newline at end of file
@@ -7,33 +7,38 @@ namespace Hderiva {
 
 // (d / dx * H)c = Ud^T. (d / dx * Hd) . Ud
 
+// The dot product to define the composite representation may come with a metric S,
+// otherwise leave S undefined for the Euclidean one
+
 // d / dc * Hc = Ud^T. (d / dc * Hd) . Ud + [Hc, M]
 at::Tensor DcHc
 (const at::Tensor & Hc, const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec);
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S = at::Tensor());
 
 // d / dc * (d / dx * H)c = Ud^T. (d / dc * d / dx * Hd) . Ud + [(d / dx * H)c, M]
 at::Tensor DcDxHc
 (const at::Tensor & DxHc, const at::Tensor & DxHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec);
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S = at::Tensor());
 
 // Compute d / dc * Hc and d / dc * (d / dx * H)c together
 std::tuple<at::Tensor, at::Tensor> DcHc_DcDxHc
 (const at::Tensor & Hc, const at::Tensor & DxHc,
 const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec);
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S = at::Tensor());
 
-// dot product defined with a metric S
-at::Tensor DcHc
-(const at::Tensor & Hc, const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S);
-at::Tensor DcDxHc
-(const at::Tensor & DxHc, const at::Tensor & DxHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S);
-std::tuple<at::Tensor, at::Tensor> DcHc_DcDxHc
+// Batched version of `DcHc_DcDxHc`, where the 1st index of every argument is the batch index,
+// except that S may be shared by the batch
+std::tuple<at::Tensor, at::Tensor> batch_DcHc_DcDxHc
 (const at::Tensor & Hc, const at::Tensor & DxHc,
 const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S);
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S = at::Tensor());
+
+// Block-sparse version of `DcHc_DcDxHc`, where DcHd and DcDxHd are given by the blocks of each element,
+// see `UT_blocks_U` for the layout
+std::tuple<at::Tensor, at::Tensor> block_DcHc_DcDxHc
+(const at::Tensor & Hc, const at::Tensor & DxHc,
+const at::Tensor & DxHd, const std::vector<at::Tensor> & DcHd_blocks, const std::vector<at::Tensor> & DcDxHd_blocks,
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S = at::Tensor());
 
 } // namespace Hderiva
 
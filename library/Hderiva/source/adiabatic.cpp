@@ -14,12 +14,23 @@ at::Tensor DcDxHa
 (const at::Tensor & DxHa, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
 const at::Tensor & energy, const at::Tensor & states) {
     at::Tensor nac = tchem::linalg::UT_sy_U(DcHd, states);
-    for (size_t i = 0    ; i < energy.size(0); i++)
-    for (size_t j = i + 1; j < energy.size(0); j++)
-    nac[i][j] /= energy[j] - energy[i];
+    divide_eigval_difference_(nac, energy);
     at::Tensor DcDxHa = tchem::linalg::UT_sy_U(DcDxHd, states)
                       + commutor_term(DxHa, nac);
     return DcDxHa;
 }
 
+// Block-sparse version of `DcDxHa`, see `UT_blocks_U` for the layout
+// return d / dc * Ha (whose diagonal is d / dc * E) and d / dc * (d / dx * H)a
+std::tuple<at::Tensor, at::Tensor> block_DcHa_DcDxHa
+(const at::Tensor & DxHa, const std::vector<at::Tensor> & DcHd_blocks, const std::vector<at::Tensor> & DcDxHd_blocks,
+const at::Tensor & energy, const at::Tensor & states) {
+    at::Tensor DcHa = UT_blocks_U(DcHd_blocks, states);
+    at::Tensor nac = DcHa.clone();
+    divide_eigval_difference_(nac, energy);
+    at::Tensor DcDxHa = UT_blocks_U(DcDxHd_blocks, states)
+                      + commutor_term(DxHa, nac);
+    return std::make_tuple(DcHa, DcDxHa);
+}
+
 } // namespace Hderiva
\ No newline at end of file
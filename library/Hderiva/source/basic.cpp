@@ -1,7 +1,117 @@
-#include <tchem/linalg.hpp>
+#include <torch/torch.h>
 
 namespace Hderiva {
 
+namespace {
+
+// [A, M] with a leading batch index, A and M are full matrices
+// Since A is symmetric and M is asymmetric, M . A = - (A . M)^T,
+// so [A, M] = A . M + (A . M)^T takes only 1 batched matrix multiplication
+at::Tensor batched_commutator(const at::Tensor & A, const at::Tensor & M) {
+    int64_t batch_size = A.size(0), N = A.size(1), m = M.size(-1);
+    int64_t P = A.numel() / (batch_size * N * N);
+    // T[b][i][j][p][m] = sum_k A[b][i][k][p] * M[b][k][j][m]
+    at::Tensor A_ = A.reshape({batch_size, N, N, P}).permute({0, 1, 3, 2}).reshape({batch_size, N * P, N}),
+               M_ = M.reshape({batch_size, N, N * m});
+    at::Tensor T = A_.bmm(M_).view({batch_size, N, P, N, m}).permute({0, 1, 3, 2, 4});
+    at::Tensor result = T + T.transpose(1, 2);
+    std::vector<int64_t> dims = A.sizes().vec();
+    dims.push_back(m);
+    return result.reshape(dims);
+}
+
+}
+
+// Return A with the "lower triangle" (i > j) filled from the "upper triangle"
+// The matrix indices are the `dim`-th and (`dim` + 1)-th indices
+// symmetric: A[i][j] =  A[j][i], read the "upper triangle" (i <= j)
+// asymmetric: A[i][j] = -A[j][i], read the "strict upper triangle" (i < j)
+// Unread elements may hold anything (e.g. from `new_empty`), so mask rather than multiply
+at::Tensor fill_lower_triangle(const at::Tensor & A, const int64_t & dim, const bool & symmetric) {
+    int64_t N = A.size(dim);
+    std::vector<int64_t> mask_sizes(A.sizes().size(), 1);
+    mask_sizes[dim] = N;
+    mask_sizes[dim + 1] = N;
+    at::Tensor ones = A.new_ones({N, N});
+    at::Tensor not_upper = ones.triu(symmetric ? 0 : 1).lt(0.5).view(mask_sizes),
+               not_strict_upper = ones.triu(1).lt(0.5).view(mask_sizes);
+    at::Tensor upper = A.masked_fill(not_upper, 0.0),
+               lower = A.masked_fill(not_strict_upper, 0.0).transpose(dim, dim + 1);
+    return symmetric ? upper + lower : upper - lower;
+}
+
+// M[i][j] /= eigval[j] - eigval[i] for the "strict upper triangle" (i < j) of M,
+// other elements are untouched
+// M may have additional trailing indices, and a leading batch index if eigval is batched
+at::Tensor & divide_eigval_difference_(at::Tensor & M, const at::Tensor & eigval) {
+    // dE[i][j] = eigval[j] - eigval[i] in the strict upper triangle, 1 elsewhere
+    at::Tensor dE = eigval.unsqueeze(-2) - eigval.unsqueeze(-1);
+    dE = dE.triu(1) + at::ones_like(dE).tril();
+    std::vector<int64_t> sizes = dE.sizes().vec();
+    sizes.resize(M.sizes().size(), 1);
+    M /= dE.view(sizes);
+    return M;
+}
+
+// Batched version of tchem::linalg::UT_sy_U, where the 1st index of A and U is the batch index
+// Only read the "upper triangle" (i <= j) of A
+// The output tensor is fully written
+at::Tensor batch_UT_sy_U(const at::Tensor & A, const at::Tensor & U) {
+    if (A.sizes().size() < 3) throw std::invalid_argument(
+    "Hderiva::batch_UT_sy_U: A must be a batch of matrices or higher order tensors");
+    if (U.sizes().size() != 3) throw std::invalid_argument(
+    "Hderiva::batch_UT_sy_U: U must be a batch of matrices");
+    if (A.size(0) != U.size(0)) throw std::invalid_argument(
+    "Hderiva::batch_UT_sy_U: A & U must have a same batch size");
+    if (A.size(1) != A.size(2)) throw std::invalid_argument(
+    "Hderiva::batch_UT_sy_U: The matrix part of A must be square");
+    if (A.size(1) != U.size(1)) throw std::invalid_argument(
+    "Hderiva::batch_UT_sy_U: A & U must be matrix mutiplicable");
+    int64_t batch_size = A.size(0), N = A.size(1);
+    int64_t P = A.numel() / (batch_size * N * N);
+    at::Tensor A_full = fill_lower_triangle(A, 1, true)
+                        .reshape({batch_size, N, N, P}).permute({0, 3, 1, 2});
+    at::Tensor result = U.transpose(1, 2).unsqueeze(1).matmul(A_full).matmul(U.unsqueeze(1));
+    return result.permute({0, 2, 3, 1}).reshape(A.sizes());
+}
+
+// Block-sparse version of tchem::linalg::UT_sy_U for the parameter derivative of a symmetric matrix,
+// where each "upper triangle" element only depends on its own block of parameters:
+// blocks[l] is the derivative of element l (line by line: 00, 01, ..., 0N, 11, 12, ...)
+// over its own parameters, with the parameter index at the end
+// `blocks` may cycle through the elements several times, e.g. for a sum of networks
+// The parameters are concatenated in the order of `blocks`
+// The output tensor is fully written, with the concatenated parameter index at the end
+// Block ij contributes (U^T . (e_i e_j^T + e_j e_i^T) . U) x block = (U_i U_j^T + U_j U_i^T) x block,
+// costing N^2 rather than the N^3 of a dense rotation per parameter
+at::Tensor UT_blocks_U(const std::vector<at::Tensor> & blocks, const at::Tensor & U) {
+    if (U.sizes().size() != 2) throw std::invalid_argument(
+    "Hderiva::UT_blocks_U: U must be a matrix");
+    int64_t N = U.size(0);
+    if (blocks.size() % (N * (N + 1) / 2) != 0) throw std::invalid_argument(
+    "Hderiva::UT_blocks_U: the number of blocks must be a multiple of the number of upper triangle elements");
+    std::vector<at::Tensor> results(blocks.size());
+    int64_t i = 0, j = 0;
+    for (size_t l = 0; l < blocks.size(); l++) {
+        at::Tensor W = U[i].outer(U[j]);
+        if (i != j) W = W + W.transpose(0, 1);
+        std::vector<int64_t> sizes = {N, N};
+        sizes.resize(2 + blocks[l].sizes().size(), 1);
+        results[l] = W.view(sizes) * blocks[l];
+        // next element
+        j++;
+        if (j == N) {
+            i++;
+            j = i;
+        }
+        if (i == N) {
+            i = 0;
+            j = 0;
+        }
+    }
+    return at::cat(results, -1);
+}
+
 // This routine calculates the [Ax, M] term in differentiating Ax
 // A must be a matrix or higher order tensor, with the first 2 indices as the matrix indices
 // M must be a 3rd-order tensor, with the last index as the gradient index
@@ -11,7 +121,7 @@ namespace Hderiva {
 // So the result is symmetric
 // Only read the "upper triangle" (i <= j) of A
 // Only read the "strict upper triangle" (i < j) of M
-// Only write the "upper triangle" (i <= j) of the output tensor
+// The output tensor is fully written
 at::Tensor commutor_term(const at::Tensor & A, const at::Tensor & M) {
     if (A.sizes().size() < 2) throw std::invalid_argument(
     "Hderiva::commutor_term: A must be a matrix or higher order tensor");
@@ -23,41 +133,28 @@ at::Tensor commutor_term(const at::Tensor & A, const at::Tensor & M) {
     "Hderiva::commutor_term: The matrix part of M must be square");
     if (A.size(1) != M.size(0)) throw std::invalid_argument(
     "Hderiva::commutor_term: A & M must be matrix mutiplicable");
-    std::vector<int64_t> dims(A.sizes().size() + 1);
-    for (size_t i = 0; i < A.sizes().size(); i++) dims[i] = A.size(i);
-    dims.back() = M.size(-1);
-    c10::IntArrayRef sizes(dims.data(), dims.size());
-    at::Tensor result = A.new_zeros(sizes);
-    size_t N = A.size(0);
-    for (size_t i = 0; i < N; i++) {
-        // k < i = j
-        for (size_t k = 0; k < i; k++)
-        result[i][i] += tchem::linalg::outer_product(A[k][i], M[k][i]);
-        // i = j < k
-        for (size_t k = i + 1; k < N; k++)
-        result[i][i] -= tchem::linalg::outer_product(A[i][k], M[i][k]);
-        result[i][i] *= 2.0;
-        // i < j
-        for (size_t j = i + 1; j < N; j++) {
-            // k < i < j
-            for (size_t k = 0; k < i; k++)
-            result[i][j] += tchem::linalg::outer_product(A[k][i],  M[k][j])
-                          - tchem::linalg::outer_product(A[k][j], -M[k][i]);
-            // k = i < j
-            result[i][j] += tchem::linalg::outer_product(A[i][i],  M[i][j]);
-            // i < k < j, exist only if j - i >= 2
-            for (size_t k = i + 1; k < j; k++)
-            result[i][j] += tchem::linalg::outer_product(A[i][k], M[k][j])
-                          - tchem::linalg::outer_product(A[k][j], M[i][k]);
-            // i < j = k
-            result[i][j] -= tchem::linalg::outer_product(A[j][j], M[i][j]);
-            // i < j < k
-            for (size_t k = j + 1; k < N; k++)
-            result[i][j] += tchem::linalg::outer_product(A[i][k], -M[j][k])
-                          - tchem::linalg::outer_product(A[j][k],  M[i][k]);
-        }
-    }
-    return result;
+    at::Tensor A_full = fill_lower_triangle(A, 0, true),
+               M_full = fill_lower_triangle(M, 0, false);
+    return batched_commutator(A_full.unsqueeze(0), M_full.unsqueeze(0)).squeeze(0);
+}
+
+// Batched version of `commutor_term`, where the 1st index of A and M is the batch index
+at::Tensor batch_commutor_term(const at::Tensor & A, const at::Tensor & M) {
+    if (A.sizes().size() < 3) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: A must be a batch of matrices or higher order tensors");
+    if (M.sizes().size() != 4) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: M must be a batch of 3rd-order tensors");
+    if (A.size(0) != M.size(0)) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: A & M must have a same batch size");
+    if (A.size(1) != A.size(2)) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: The matrix part of A must be square");
+    if (M.size(1) != M.size(2)) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: The matrix part of M must be square");
+    if (A.size(2) != M.size(1)) throw std::invalid_argument(
+    "Hderiva::batch_commutor_term: A & M must be matrix mutiplicable");
+    at::Tensor A_full = fill_lower_triangle(A, 1, true),
+               M_full = fill_lower_triangle(M, 1, false);
+    return batched_commutator(A_full, M_full);
 }
 
 } // namespace Hderiva
\ No newline at end of file
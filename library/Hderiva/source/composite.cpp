@@ -4,19 +4,71 @@
 
 namespace Hderiva {
 
+namespace {
+
+// M = Ud^T . (d / dc * (d / dx * Hd) . (d / dx * Hd)) . Ud / ΔE,
+// where the dot product is defined with a metric S (undefined S means identity)
+// Only the "strict upper triangle" (i < j) of M is meaningful
+at::Tensor composite_nac(const at::Tensor & DxHd, const at::Tensor & DcDxHd,
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
+    at::Tensor DcO = S.defined()
+                   ? tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd, S)
+                   : tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd);
+    DcO = DcO + DcO.transpose(0, 1);
+    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
+    divide_eigval_difference_(nac, eigval);
+    return nac;
+}
+
+// Block-sparse version of `composite_nac`, see `UT_blocks_U` for the layout
+// Block ij of d / dc * (d / dx * Hd) . (d / dx * Hd) has only row i (T_j) and row j (T_i),
+// where T_j = (d / dc * d / dx * Hd)_ij . (d / dx * Hd)_j with the x index contracted,
+// so after symmetrization and rotation block ij is Ud_i x Ud^T.T_j + Ud^T.T_j x Ud_i + (i <-> j)
+at::Tensor block_composite_nac(const at::Tensor & DxHd, const std::vector<at::Tensor> & DcDxHd_blocks,
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
+    int64_t N = eigvec.size(0);
+    if (DcDxHd_blocks.size() % (N * (N + 1) / 2) != 0) throw std::invalid_argument(
+    "Hderiva::block_composite_nac: the number of blocks must be a multiple of the number of upper triangle elements");
+    at::Tensor DxHd_full = fill_lower_triangle(DxHd, 0, true);
+    at::Tensor SDxHd = S.defined() ? DxHd_full.matmul(S) : DxHd_full;
+    // V[k][q][x] = sum_j (S . d / dx * Hd)[k][j][x] Ud[j][q]
+    at::Tensor V = at::einsum("kjx,jq->kqx", {SDxHd, eigvec});
+    std::vector<at::Tensor> nacs(DcDxHd_blocks.size());
+    int64_t i = 0, j = 0;
+    for (size_t l = 0; l < DcDxHd_blocks.size(); l++) {
+        at::Tensor UTTj = V[j].mm(DcDxHd_blocks[l]);
+        at::Tensor nac = eigvec[i].view({N, 1, 1}) * UTTj.unsqueeze(0);
+        if (i != j) {
+            at::Tensor UTTi = V[i].mm(DcDxHd_blocks[l]);
+            nac = nac + eigvec[j].view({N, 1, 1}) * UTTi.unsqueeze(0);
+        }
+        nacs[l] = nac + nac.transpose(0, 1);
+        // next element
+        j++;
+        if (j == N) {
+            i++;
+            j = i;
+        }
+        if (i == N) {
+            i = 0;
+            j = 0;
+        }
+    }
+    at::Tensor nac = at::cat(nacs, -1);
+    divide_eigval_difference_(nac, eigval);
+    return nac;
+}
+
+}
+
 // (d / dx * H)c = Ud^T. (d / dx * Hd) . Ud
 
 // d / dc * Hc = Ud^T. (d / dc * Hd) . Ud
 //             + [Hc, M]
 at::Tensor DcHc
 (const at::Tensor & Hc, const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
+    at::Tensor nac = composite_nac(DxHd, DcDxHd, eigval, eigvec, S);
     at::Tensor DcHc = tchem::linalg::UT_sy_U(DcHd, eigvec)
                     + commutor_term(Hc, nac);
     return DcHc;
@@ -26,13 +78,8 @@ const at::Tensor & eigval, const at::Tensor & eigvec) {
 //                        + [(d / dx * H)c, M]
 at::Tensor DcDxHc
 (const at::Tensor & DxHc, const at::Tensor & DxHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
+    at::Tensor nac = composite_nac(DxHd, DcDxHd, eigval, eigvec, S);
     at::Tensor DcDxHc = tchem::linalg::UT_sy_U(DcDxHd, eigvec)
                       + commutor_term(DxHc, nac);
     return DcDxHc;
@@ -41,13 +88,8 @@ const at::Tensor & eigval, const at::Tensor & eigvec) {
 std::tuple<at::Tensor, at::Tensor> DcHc_DcDxHc
 (const at::Tensor & Hc, const at::Tensor & DxHc,
 const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
+const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
+    at::Tensor nac = composite_nac(DxHd, DcDxHd, eigval, eigvec, S);
     at::Tensor DcHc = tchem::linalg::UT_sy_U(DcHd, eigvec)
                     + commutor_term(Hc, nac);
     at::Tensor DcDxHc = tchem::linalg::UT_sy_U(DcDxHd, eigvec)
@@ -55,47 +97,46 @@ const at::Tensor & eigval, const at::Tensor & eigvec) {
     return std::make_tuple(DcHc, DcDxHc);
 }
 
-// dot product defined with a metric S
-at::Tensor DcHc
-(const at::Tensor & Hc, const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
+// Block-sparse version of `DcHc_DcDxHc`, see `UT_blocks_U` for the layout
+std::tuple<at::Tensor, at::Tensor> block_DcHc_DcDxHc
+(const at::Tensor & Hc, const at::Tensor & DxHc,
+const at::Tensor & DxHd, const std::vector<at::Tensor> & DcHd_blocks, const std::vector<at::Tensor> & DcDxHd_blocks,
 const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd, S);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
-    at::Tensor DcHc = tchem::linalg::UT_sy_U(DcHd, eigvec)
+    at::Tensor nac = block_composite_nac(DxHd, DcDxHd_blocks, eigval, eigvec, S);
+    at::Tensor DcHc = UT_blocks_U(DcHd_blocks, eigvec)
                     + commutor_term(Hc, nac);
-    return DcHc;
-}
-at::Tensor DcDxHc
-(const at::Tensor & DxHc, const at::Tensor & DxHd, const at::Tensor & DcDxHd,
-const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd, S);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
-    at::Tensor DcDxHc = tchem::linalg::UT_sy_U(DcDxHd, eigvec)
+    at::Tensor DcDxHc = UT_blocks_U(DcDxHd_blocks, eigvec)
                       + commutor_term(DxHc, nac);
-    return DcDxHc;
+    return std::make_tuple(DcHc, DcDxHc);
 }
-std::tuple<at::Tensor, at::Tensor> DcHc_DcDxHc
+
+// Batched version of `DcHc_DcDxHc`, where the 1st index of every argument is the batch index,
+// except that S may be shared by the batch
+std::tuple<at::Tensor, at::Tensor> batch_DcHc_DcDxHc
 (const at::Tensor & Hc, const at::Tensor & DxHc,
 const at::Tensor & DxHd, const at::Tensor & DcHd, const at::Tensor & DcDxHd,
 const at::Tensor & eigval, const at::Tensor & eigvec, const at::Tensor & S) {
-    at::Tensor DcO = tchem::linalg::sy4matmvmulsy3(DcDxHd.transpose(-1, -2), DxHd, S);
-    DcO = DcO + DcO.transpose(0, 1);
-    at::Tensor nac = tchem::linalg::UT_sy_U(DcO, eigvec);
-    for (size_t i = 0    ; i < eigval.size(0); i++)
-    for (size_t j = i + 1; j < eigval.size(0); j++)
-    nac[i][j] /= eigval[j] - eigval[i];
-    at::Tensor DcHc = tchem::linalg::UT_sy_U(DcHd, eigvec)
-                    + commutor_term(Hc, nac);
-    at::Tensor DcDxHc = tchem::linalg::UT_sy_U(DcDxHd, eigvec)
-                      + commutor_term(DxHc, nac);
+    if (DxHd.sizes().size() != 4) throw std::invalid_argument(
+    "Hderiva::batch_DcHc_DcDxHc: DxHd must be a batch of 3rd-order tensors");
+    if (DcDxHd.sizes().size() != 5) throw std::invalid_argument(
+    "Hderiva::batch_DcHc_DcDxHc: DcDxHd must be a batch of 4th-order tensors");
+    if (eigval.sizes().size() != 2) throw std::invalid_argument(
+    "Hderiva::batch_DcHc_DcDxHc: eigval must be a batch of vectors");
+    at::Tensor   DxHd_full = fill_lower_triangle(  DxHd, 1, true),
+               DcDxHd_full = fill_lower_triangle(DcDxHd, 1, true);
+    at::Tensor SDxHd = DxHd_full;
+    if (S.defined()) {
+        if (S.sizes().size() == 2) SDxHd = DxHd_full.matmul(S);
+        else SDxHd = DxHd_full.unsqueeze(-2).matmul(S.unsqueeze(1).unsqueeze(1)).squeeze(-2);
+    }
+    at::Tensor DcO = at::einsum("bikxc,bkjx->bijc", {DcDxHd_full, SDxHd});
+    DcO = DcO + DcO.transpose(1, 2);
+    at::Tensor nac = batch_UT_sy_U(DcO, eigvec);
+    divide_eigval_difference_(nac, eigval);
+    at::Tensor DcHc = batch_UT_sy_U(DcHd, eigvec)
+                    + batch_commutor_term(Hc, nac);
+    at::Tensor DcDxHc = batch_UT_sy_U(DcDxHd, eigvec)
+                      + batch_commutor_term(DxHc, nac);
     return std::make_tuple(DcHc, DcDxHc);
 }
 
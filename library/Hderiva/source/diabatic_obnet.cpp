@@ -32,5 +32,7 @@ const bool & create_graph = false) {
 // Q: Why not a specialized DcDxHd?
 // A: In that way we would backward through d / dls * Hd elements,
 //    but ls usually have magnitudes more elements than x
+//    For the tanh networks of library *obnet* there are closed-form routines instead:
+//    obnet::symat::forward_Dc for DcHd and obnet::symat::forward_Dc_DcDx for DcDxHd
 
 }
\ No newline at end of file
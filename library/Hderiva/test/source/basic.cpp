@@ -0,0 +1,95 @@
+#include <tchem/linalg.hpp>
+
+#include <Hderiva/basic.hpp>
+#include <Hderiva/adiabatic.hpp>
+#include <Hderiva/composite.hpp>
+
+void basic() {
+    std::cout << "Testing basic routines...\n";
+
+    c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
+    int64_t N = 4, dim = 3, NPars = 5;
+    // A is symmetric, M is asymmetric
+    // Fill their "lower triangles" with garbage, which should never be read
+    at::Tensor A = at::rand({N, N, dim}, top),
+               M = at::rand({N, N, NPars}, top);
+    at::Tensor A_full = A.new_empty(A.sizes()),
+               M_full = M.new_zeros(M.sizes());
+    for (size_t i = 0; i < N; i++)
+    for (size_t j = i; j < N; j++) {
+        A_full[i][j] = A[i][j];
+        A_full[j][i] = A[i][j];
+        if (i < j) {
+            M_full[i][j] =  M[i][j];
+            M_full[j][i] = -M[i][j];
+            A[j][i] = NAN;
+            M[j][i] = NAN;
+        }
+    }
+    at::Tensor result_A = at::zeros({N, N, dim, NPars}, top);
+    for (size_t i = 0; i < N; i++)
+    for (size_t j = 0; j < N; j++)
+    for (size_t k = 0; k < N; k++)
+    result_A[i][j] += at::ger(A_full[i][k], M_full[k][j]) - at::ger(A_full[k][j], M_full[i][k]);
+    at::Tensor result = Hderiva::commutor_term(A, M);
+    std::cout << "\n[A, M]: " << (result - result_A).norm().item<double>() << '\n';
+
+    at::Tensor As = at::stack({A, 2.0 * A}),
+               Ms = at::stack({M, M});
+    at::Tensor results = Hderiva::batch_commutor_term(As, Ms);
+    std::cout << "\nbatched [A, M]: " << (results[0] - result_A).norm().item<double>()
+              << ' ' << (results[1] - 2.0 * result_A).norm().item<double>() << '\n';
+
+    at::Tensor DxHd = at::rand({N, N, dim}, top),
+               DcHd = at::rand({N, N, NPars}, top),
+             DcDxHd = at::rand({N, N, dim, NPars}, top);
+    at::Tensor eigval, eigvec;
+    std::tie(eigval, eigvec) = at::rand({N, N}, top).symeig(true);
+    at::Tensor   Hc = at::rand({N, N}, top),
+               DxHc = at::rand({N, N, dim}, top);
+    at::Tensor DcHc, DcDxHc;
+    std::tie(DcHc, DcDxHc) = Hderiva::DcHc_DcDxHc(Hc, DxHc, DxHd, DcHd, DcDxHd, eigval, eigvec);
+    at::Tensor DcHcs, DcDxHcs;
+    std::tie(DcHcs, DcDxHcs) = Hderiva::batch_DcHc_DcDxHc(
+        Hc.unsqueeze(0), DxHc.unsqueeze(0), DxHd.unsqueeze(0), DcHd.unsqueeze(0), DcDxHd.unsqueeze(0),
+        eigval.unsqueeze(0), eigvec.unsqueeze(0));
+    std::cout << "\nbatched d / dc * Hc and d / dc * (d / dx * H)c: "
+              << (DcHcs[0] - DcHc).triu().norm().item<double>() << ' '
+              << (DcDxHcs[0] - DcDxHc).permute({2, 3, 0, 1}).triu().norm().item<double>() << '\n';
+
+    // blocks cycling through the "upper triangle" twice, as for a sum of 2 networks
+    std::vector<at::Tensor> DcHd_blocks, DcDxHd_blocks;
+    int64_t NPars_blocks = 0;
+    for (size_t l = 0; l < N * (N + 1); l++) {
+        int64_t n = l % 3 + 1;
+        DcHd_blocks.push_back(at::rand(n, top));
+        DcDxHd_blocks.push_back(at::rand({dim, n}, top));
+        NPars_blocks += n;
+    }
+    at::Tensor DcHd_dense = at::zeros({N, N, NPars_blocks}, top),
+             DcDxHd_dense = at::zeros({N, N, dim, NPars_blocks}, top);
+    size_t count = 0;
+    int64_t start = 0;
+    for (size_t cycle = 0; cycle < 2; cycle++)
+    for (size_t i = 0; i < N; i++)
+    for (size_t j = i; j < N; j++) {
+        int64_t stop = start + DcHd_blocks[count].size(0);
+          DcHd_dense[i][j].slice(0, start, stop).copy_(  DcHd_blocks[count]);
+        DcDxHd_dense[i][j].slice(1, start, stop).copy_(DcDxHd_blocks[count]);
+        start = stop;
+        count++;
+    }
+    at::Tensor DxHa = at::rand({N, N, dim}, top);
+    at::Tensor DcHa_block, DcDxHa_block;
+    std::tie(DcHa_block, DcDxHa_block) = Hderiva::block_DcHa_DcDxHa(DxHa, DcHd_blocks, DcDxHd_blocks, eigval, eigvec);
+    at::Tensor DcDxHa = Hderiva::DcDxHa(DxHa, DcHd_dense, DcDxHd_dense, eigval, eigvec);
+    std::cout << "\nblock-sparse d / dc * Ha and d / dc * (d / dx * H)a: "
+              << (DcHa_block - tchem::linalg::UT_sy_U(DcHd_dense, eigvec)).permute({2, 0, 1}).triu().norm().item<double>() << ' '
+              << (DcDxHa_block - DcDxHa).permute({2, 3, 0, 1}).triu().norm().item<double>() << '\n';
+    at::Tensor DcHc_block, DcDxHc_block;
+    std::tie(DcHc_block, DcDxHc_block) = Hderiva::block_DcHc_DcDxHc(Hc, DxHc, DxHd, DcHd_blocks, DcDxHd_blocks, eigval, eigvec);
+    std::tie(DcHc, DcDxHc) = Hderiva::DcHc_DcDxHc(Hc, DxHc, DxHd, DcHd_dense, DcDxHd_dense, eigval, eigvec);
+    std::cout << "\nblock-sparse d / dc * Hc and d / dc * (d / dx * H)c: "
+              << (DcHc_block - DcHc).permute({2, 0, 1}).triu().norm().item<double>() << ' '
+              << (DcDxHc_block - DcDxHc).permute({2, 3, 0, 1}).triu().norm().item<double>() << '\n';
+}
\ No newline at end of file
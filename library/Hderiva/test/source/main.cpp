@@ -3,6 +3,8 @@
 
 #include "../include/global.hpp"
 
+void basic();
+
 void diabatic_obnet();
 
 void diabatic_DimRed_obnet();
@@ -10,6 +12,9 @@ void diabatic_DimRed_obnet();
 int main(const size_t & argc, const char ** & argv) {
     sasicset = std::make_shared<SASDIC::SASDICSet>("default", "IntCoordDef", "SAS.in");
 
+    basic();
+    std::cout << '\n';
+
     diabatic_obnet();
     std::cout << '\n';
 
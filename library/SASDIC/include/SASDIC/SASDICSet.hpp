@@ -12,8 +12,16 @@ namespace SASDIC {
 // a set of symmetry adapted and scaled dimensionless internal coordinates
 class SASDICSet : public tchem::IC::IntCoordSet {
     private:
+        // internal coordinate definition format
+        std::string format_;
+        // the files this set is read from: internal coordinate definition, SAS definition and origin
+        std::vector<std::string> definition_files_;
         // internal coordinate origin
         at::Tensor origin_;
+        // The dimensionless internal coordinates vector is
+        //     DICs = (q - origin_) * dic_scale_
+        // where dic_scale_ = 1 / origin_ for stretchings, 1 for others
+        at::Tensor dic_scale_;
         // Internal coordinates with no scaling are picked out by scaling_complete_ matrix
         // The scaled dimensionless internal coordinates vector is
         //     SDICs = scaling_complete_.mv(DICs)
@@ -24,6 +32,12 @@ class SASDICSet : public tchem::IC::IntCoordSet {
         // sasdicss_[i][j] contains the definition of
         // j-th symmetry adapted internal coordinate in i-th irreducible
         std::vector<std::vector<SASDIC>> sasdicss_;
+        // sasdicss_ as linear maps: the SASDICs of i-th irreducible are
+        //     symmetrizers_[i].mv(SDICs)
+        std::vector<at::Tensor> symmetrizers_;
+
+        // check the shape of internal coordinates q
+        void check_(const at::Tensor & q, const std::string & caller) const;
     public:
         SASDICSet();
         // internal coordinate definition format (Columbus7, default)
@@ -32,6 +46,10 @@ class SASDICSet : public tchem::IC::IntCoordSet {
         SASDICSet(const std::string & format, const std::string & IC_file, const std::string & SAS_file);
         ~SASDICSet();
 
+        const std::string & format() const;
+        // the files this set is read from: internal coordinate definition, SAS definition and origin,
+        // i.e. SASDIC depends on nothing else but `format()`
+        const std::vector<std::string> & definition_files() const;
         const at::Tensor & origin() const;
 
         // number of irreducible representations
@@ -42,7 +60,17 @@ class SASDICSet : public tchem::IC::IntCoordSet {
         size_t intdim() const;
 
         // given internal coordinates q, return SASDIC
+        // q can be a vector or a batch of vectors (B x intdim),
+        // then each SASDIC is a vector or B x (number of SASDICs in this irreducible)
         std::vector<at::Tensor> operator()(const at::Tensor & q) const;
+        // given internal coordinates q, return SASDIC and the Jacobian of SASDIC over q
+        // Same batching as operator(), each Jacobian is a matrix or B x (number of SASDICs in this irreducible) x intdim
+        // The Jacobian is analytical, so q needs not require gradient
+        std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> compute_SASDIC_J(const at::Tensor & q) const;
+        // given internal coordinate vector q, return SASDIC, the Jacobian and the Hessian of SASDIC over q
+        // Each Hessian is (number of SASDICs in this irreducible) x intdim x intdim
+        // Both are analytical, so q needs not require gradient
+        std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>, std::vector<at::Tensor>> compute_SASDIC_J_Hess(const at::Tensor & q) const;
 };
 
 } // namespace SASDIC
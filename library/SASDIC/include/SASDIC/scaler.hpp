@@ -7,10 +7,28 @@ namespace SASDIC {
 
 // scale a dimensionless internal coordinate
 class Scaler {
+    public:
+        // available scaling functions
+        enum class Type {
+            exp,      // exp(-a*x)
+            tanh,     // tanh((x-a)/b)
+            exp_power // exp(-a*x)*(1+x)^b
+        };
     private:
         size_t self_, other_;
-        std::string type_;
+        Type type_;
         std::vector<double> parameters_;
+        // constants precomputed from parameters_
+        double a_ = 0.0, b_ = 0.0, inverse_maximum_ = 1.0;
+
+        // resolve the scaling function name, check parameters_ then precompute the constants
+        void parse_(const std::string & type);
+
+        // the scaling function of x = DICs[other_]
+        at::Tensor scaling_(const at::Tensor & x) const;
+        // its 1st and 2nd order derivatives, given x and the scaling function f at x
+        at::Tensor scaling_derivative_(const at::Tensor & x, const at::Tensor & f) const;
+        at::Tensor scaling_2nd_derivative_(const at::Tensor & x, const at::Tensor & f, const at::Tensor & df) const;
     public:
         Scaler();
         Scaler(const size_t & _self, const size_t & _other, const std::string & _type, const std::vector<double> & _parameters);
@@ -20,10 +38,17 @@ class Scaler {
 
         const size_t & self() const;
         const size_t & other() const;
+        const Type & type() const;
 
-        // given dimensionless internal coordinates,
+        // given dimensionless internal coordinates (in the last dimension),
         // return scaled dimensionless internal coordinate
         at::Tensor operator()(const at::Tensor & DICs) const;
+        // given dimensionless internal coordinates (in the last dimension),
+        // return scaled dimensionless internal coordinate and its gradient over DICs
+        std::tuple<at::Tensor, at::Tensor> compute_SDIC_grad(const at::Tensor & DICs) const;
+        // given dimensionless internal coordinates (in the last dimension),
+        // return scaled dimensionless internal coordinate, its gradient and Hessian over DICs
+        std::tuple<at::Tensor, at::Tensor, at::Tensor> compute_SDIC_grad_Hess(const at::Tensor & DICs) const;
 };
 
 } // namespace SASDIC
@@ -7,10 +7,27 @@ namespace SASDIC {
 
 // scale a dimensionless internal coordinate with 2 scalers
 class Scaler2 {
+    public:
+        // available scaling functions
+        enum class Type {
+            exp_power // exp[-a*(x+y)]*[(1+x)*(1+y)]^b
+        };
     private:
         size_t self_, other1_, other2_;
-        std::string type_;
+        Type type_;
         std::vector<double> parameters_;
+        // constants precomputed from parameters_
+        double a_ = 0.0, b_ = 0.0, inverse_maximum_ = 1.0;
+
+        // resolve the scaling function name, check parameters_ then precompute the constants
+        void parse_(const std::string & type);
+
+        // the scaling function of x = DICs[other1_] and y = DICs[other2_]
+        at::Tensor scaling_(const at::Tensor & x, const at::Tensor & y) const;
+        // its partial derivatives over x and y, given x, y and the scaling function f at (x, y)
+        std::tuple<at::Tensor, at::Tensor> scaling_derivatives_(const at::Tensor & x, const at::Tensor & y, const at::Tensor & f) const;
+        // its 2nd order partial derivatives over xx, yy, xy, given x, y and the scaling function f at (x, y)
+        std::tuple<at::Tensor, at::Tensor, at::Tensor> scaling_2nd_derivatives_(const at::Tensor & x, const at::Tensor & y, const at::Tensor & f) const;
     public:
         Scaler2();
         Scaler2(const size_t & _self, const size_t & _other1, const size_t & _other2, const std::string & _type, const std::vector<double> & _parameters);
@@ -21,10 +38,17 @@ class Scaler2 {
         const size_t & self() const;
         const size_t & other1() const;
         const size_t & other2() const;
+        const Type & type() const;
 
-        // given dimensionless internal coordinates,
+        // given dimensionless internal coordinates (in the last dimension),
         // return scaled dimensionless internal coordinate
         at::Tensor operator()(const at::Tensor & DICs) const;
+        // given dimensionless internal coordinates (in the last dimension),
+        // return scaled dimensionless internal coordinate and its gradient over DICs
+        std::tuple<at::Tensor, at::Tensor> compute_SDIC_grad(const at::Tensor & DICs) const;
+        // given dimensionless internal coordinates (in the last dimension),
+        // return scaled dimensionless internal coordinate, its gradient and Hessian over DICs
+        std::tuple<at::Tensor, at::Tensor, at::Tensor> compute_SDIC_grad_Hess(const at::Tensor & DICs) const;
 };
 
 } // namespace SASDIC
@@ -14,7 +14,7 @@ SASDICSet::SASDICSet() {}
 // internal coordinate definition file
 // symmetry adaptation and scale definition file
 SASDICSet::SASDICSet(const std::string & format, const std::string & IC_file, const std::string & SAS_file)
-: tchem::IC::IntCoordSet(format, IC_file) {
+: tchem::IC::IntCoordSet(format, IC_file), format_(format), definition_files_({IC_file, SAS_file}) {
     int64_t intdim = this->IntCoordSet::size();
     c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
     std::ifstream ifs; ifs.open(SAS_file);
@@ -26,7 +26,12 @@ SASDICSet::SASDICSet(const std::string & format, const std::string & IC_file, co
         std::getline(ifs, line);
         std::getline(ifs, origin_file);
         CL::utility::trim(origin_file);
+        definition_files_.push_back(origin_file);
         origin_ = tchem::utility::read_vector(origin_file);
+        dic_scale_ = at::ones(intdim, top);
+        for (size_t i = 0; i < intdim; i++)
+        if ((*this)[i][0].second.type() == tchem::IC::InvDisp_type::stretching)
+        dic_scale_[i].fill_(1.0 / origin_[i].item<double>());
         // internal coordinates to be scaled
         std::getline(ifs, line);
         while (true) {
@@ -73,9 +78,20 @@ SASDICSet::SASDICSet(const std::string & format, const std::string & IC_file, co
         }
     }
     ifs.close();
+    // symmetry adapted linear combinations as matrices
+    symmetrizers_.resize(sasdicss_.size());
+    for (size_t i = 0; i < sasdicss_.size(); i++) {
+        symmetrizers_[i] = at::zeros({(int64_t)sasdicss_[i].size(), intdim}, top);
+        for (size_t j = 0; j < sasdicss_[i].size(); j++)
+        for (const auto & coeff_index : sasdicss_[i][j].coeff_indices())
+        symmetrizers_[i][j][coeff_index.second] += coeff_index.first;
+    }
 }
 SASDICSet::~SASDICSet() {}
 
+const std::string & SASDICSet::format() const {return format_;}
+// the files this set is read from: internal coordinate definition, SAS definition and origin
+const std::vector<std::string> & SASDICSet::definition_files() const {return definition_files_;}
 const at::Tensor & SASDICSet::origin() const {return origin_;}
 
 // number of irreducible representations
@@ -93,35 +109,109 @@ size_t SASDICSet::intdim() const {
     return intdim;
 }
 
+// check the shape of internal coordinates q
+void SASDICSet::check_(const at::Tensor & q, const std::string & caller) const {
+    if (q.sizes().size() != 1 && q.sizes().size() != 2) throw std::invalid_argument(
+    "SASDIC::SASDICSet::" + caller + ": q must be a vector or a batch of vectors");
+    if (q.size(-1) != this->size()) throw std::invalid_argument(
+    "SASDIC::SASDICSet::" + caller + ": inconsisten dimension between q and this internal coordinate system");
+}
+
 // given internal coordinates q, return SASDIC
+// q can be a vector or a batch of vectors (B x intdim),
+// then each SASDIC is a vector or B x (number of SASDICs in this irreducible)
 std::vector<at::Tensor> SASDICSet::operator()(const at::Tensor & q) const {
-    if (q.sizes().size() != 1) throw std::invalid_argument(
-    "SASDIC::SASDICSet::operator(): q must be a vector");
-    if (q.size(0) != this->size()) throw std::invalid_argument(
-    "SASDIC::SASDICSet::operator(): inconsisten dimension between q and this internal coordinate system");
+    check_(q, "operator()");
     // nondimensionalize
-    at::Tensor dics = q - origin_;
-    for (size_t i = 0; i < this->size(); i++)
-    if ((*this)[i][0].second.type() == tchem::IC::InvDisp_type::stretching)
-    dics[i] = dics[i] / origin_[i];
+    at::Tensor dics = (q - origin_) * dic_scale_;
     // scale
-    at::Tensor sdics = scaling_complete_.mv(dics);
+    at::Tensor sdics = dics * scaling_complete_.diagonal();
+    for (const Scaler & scaler : scalers_) sdics.select(-1, scaler.self()).copy_(scaler(dics));
+    for (const Scaler2 & scaler : scaler2s_) sdics.select(-1, scaler.self()).copy_(scaler(dics));
+    // symmetrize
+    std::vector<at::Tensor> sasdicss(NIrreds());
+    for (size_t i = 0; i < NIrreds(); i++) sasdicss[i] = sdics.matmul(symmetrizers_[i].t());
+    return sasdicss;
+}
+
+// given internal coordinates q, return SASDIC and the Jacobian of SASDIC over q
+// Same batching as operator(), each Jacobian is a matrix or B x (number of SASDICs in this irreducible) x intdim
+// The Jacobian is analytical, so q needs not require gradient
+std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> SASDICSet::compute_SASDIC_J(const at::Tensor & q) const {
+    check_(q, "compute_SASDIC_J");
+    at::Tensor qs = q.sizes().size() == 1 ? q.unsqueeze(0) : q;
+    int64_t batch = qs.size(0), intdim = this->size();
+    // nondimensionalize
+    at::Tensor dics = (qs - origin_) * dic_scale_;
+    // scale, J[b][i][j] = ∂SDICs[b][i] / ∂DICs[b][j]
+    at::Tensor sdics = dics * scaling_complete_.diagonal();
+    at::Tensor J = scaling_complete_.expand({batch, intdim, intdim}).clone();
     for (const Scaler & scaler : scalers_) {
-        const size_t & self = scaler.self();
-        sdics[self] = scaler(dics);
+        at::Tensor sdic, grad;
+        std::tie(sdic, grad) = scaler.compute_SDIC_grad(dics);
+        sdics.select(-1, scaler.self()).copy_(sdic);
+        J.select(1, scaler.self()).copy_(grad);
     }
     for (const Scaler2 & scaler : scaler2s_) {
-        const size_t & self = scaler.self();
-        sdics[self] = scaler(dics);
+        at::Tensor sdic, grad;
+        std::tie(sdic, grad) = scaler.compute_SDIC_grad(dics);
+        sdics.select(-1, scaler.self()).copy_(sdic);
+        J.select(1, scaler.self()).copy_(grad);
     }
+    // chain rule of nondimensionalization, which is diagonal
+    J *= dic_scale_;
     // symmetrize
-    std::vector<at::Tensor> sasdicss(NIrreds());
+    std::vector<at::Tensor> sasdicss(NIrreds()), Js(NIrreds());
+    for (size_t i = 0; i < NIrreds(); i++) {
+        sasdicss[i] = sdics.matmul(symmetrizers_[i].t());
+        Js[i] = symmetrizers_[i].matmul(J);
+        if (q.sizes().size() == 1) {
+            sasdicss[i].squeeze_(0);
+            Js[i].squeeze_(0);
+        }
+    }
+    return std::make_tuple(sasdicss, Js);
+}
+
+// given internal coordinate vector q, return SASDIC, the Jacobian and the Hessian of SASDIC over q
+// Each Hessian is (number of SASDICs in this irreducible) x intdim x intdim
+// Only the scaled coordinates are curved, whose Hessians come from the scalers
+std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>, std::vector<at::Tensor>> SASDICSet::compute_SASDIC_J_Hess(const at::Tensor & q) const {
+    check_(q, "compute_SASDIC_J_Hess");
+    if (q.sizes().size() != 1) throw std::invalid_argument(
+    "SASDIC::SASDICSet::compute_SASDIC_J_Hess: q must be a vector");
+    int64_t intdim = this->size();
+    // nondimensionalize
+    at::Tensor dics = (q - origin_) * dic_scale_;
+    // scale, J[i][j] = ∂SDICs[i] / ∂DICs[j], H[i][j][k] = ∂2SDICs[i] / ∂DICs[j]∂DICs[k]
+    at::Tensor sdics = dics * scaling_complete_.diagonal();
+    at::Tensor J = scaling_complete_.clone(),
+               H = q.new_zeros({intdim, intdim, intdim});
+    for (const Scaler & scaler : scalers_) {
+        at::Tensor sdic, grad, Hess;
+        std::tie(sdic, grad, Hess) = scaler.compute_SDIC_grad_Hess(dics);
+        sdics[scaler.self()].copy_(sdic);
+        J[scaler.self()].copy_(grad);
+        H[scaler.self()].copy_(Hess);
+    }
+    for (const Scaler2 & scaler : scaler2s_) {
+        at::Tensor sdic, grad, Hess;
+        std::tie(sdic, grad, Hess) = scaler.compute_SDIC_grad_Hess(dics);
+        sdics[scaler.self()].copy_(sdic);
+        J[scaler.self()].copy_(grad);
+        H[scaler.self()].copy_(Hess);
+    }
+    // chain rule of nondimensionalization, which is diagonal
+    J *= dic_scale_;
+    H *= dic_scale_.outer(dic_scale_);
+    // symmetrize
+    std::vector<at::Tensor> sasdicss(NIrreds()), Js(NIrreds()), Hs(NIrreds());
     for (size_t i = 0; i < NIrreds(); i++) {
-        int64_t intdim = sasdicss_[i].size();
-        sasdicss[i] = q.new_zeros(intdim);
-        for (size_t j = 0; j < intdim; j++) sasdicss[i][j] = sasdicss_[i][j](sdics);
+        sasdicss[i] = symmetrizers_[i].mv(sdics);
+        Js[i] = symmetrizers_[i].mm(J);
+        Hs[i] = symmetrizers_[i].mm(H.view({intdim, intdim * intdim})).view({-1, intdim, intdim});
     }
-    return sasdicss;
+    return std::make_tuple(sasdicss, Js, Hs);
 }
 
 } // namespace SASDIC
\ No newline at end of file
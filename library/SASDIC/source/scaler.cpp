@@ -4,9 +4,33 @@
 
 namespace SASDIC {
 
+// resolve the scaling function name, check parameters_ then precompute the constants
+void Scaler::parse_(const std::string & type) {
+    size_t NParameters;
+    if (type == "exp(-a*x)") {
+        type_ = Type::exp;
+        NParameters = 1;
+    }
+    else if (type == "tanh((x-a)/b)") {
+        type_ = Type::tanh;
+        NParameters = 2;
+    }
+    else if (type == "exp(-a*x)*(1+x)^b") {
+        type_ = Type::exp_power;
+        NParameters = 2;
+    }
+    else throw std::invalid_argument("Unimplemented scaling function " + type);
+    if (parameters_.size() < NParameters) throw std::invalid_argument(
+    "SASDIC::Scaler::parse_: too few parameters for scaling function " + type);
+    a_ = parameters_[0];
+    if (NParameters > 1) b_ = parameters_[1];
+    // normalize exp(-a*x)*(1+x)^b to its maximum at x = b/a - 1
+    if (type_ == Type::exp_power) inverse_maximum_ = 1.0 / (exp(a_ - b_) * pow(b_ / a_, b_));
+}
+
 Scaler::Scaler() {}
 Scaler::Scaler(const size_t & _self, const size_t & _other, const std::string & _type, const std::vector<double> & _parameters)
-: self_(_self), other_(_other), type_(_type), parameters_(_parameters) {}
+: self_(_self), other_(_other), parameters_(_parameters) {parse_(_type);}
 // construct from an input line of "self    other    type    parameter(s)"
 Scaler::Scaler(const std::string & line) {
     auto strs = CL::utility::split(line);
@@ -14,37 +38,93 @@ Scaler::Scaler(const std::string & line) {
     "SASDIC::Scaler::Scaler: wrong input line");
     self_  = std::stoul(strs[0]) - 1;
     other_ = std::stoul(strs[1]) - 1;
-    type_  = strs[2];
     parameters_.resize(strs.size() - 3);
     for (size_t i = 0; i < parameters_.size(); i++) parameters_[i] = std::stod(strs[3 + i]);
+    parse_(strs[2]);
 }
 Scaler::~Scaler() {}
 
 const size_t & Scaler::self () const {return self_ ;}
 const size_t & Scaler::other() const {return other_;}
+const Scaler::Type & Scaler::type() const {return type_;}
+
+// the scaling function of x = DICs[other_]
+at::Tensor Scaler::scaling_(const at::Tensor & x) const {
+    switch (type_) {
+        case Type::exp      : return at::exp(-a_ * x);
+        case Type::tanh     : return at::tanh((x - a_) / b_);
+        case Type::exp_power: return at::exp(-a_ * x) * (1.0 + x).pow(b_) * inverse_maximum_;
+    }
+    throw std::invalid_argument("SASDIC::Scaler::scaling_: unknown scaling function");
+}
+// its 1st order derivative, given x and the scaling function f at x
+at::Tensor Scaler::scaling_derivative_(const at::Tensor & x, const at::Tensor & f) const {
+    switch (type_) {
+        case Type::exp      : return -a_ * f;
+        case Type::tanh     : return (1.0 - f * f) / b_;
+        case Type::exp_power: return f * (b_ / (1.0 + x) - a_);
+    }
+    throw std::invalid_argument("SASDIC::Scaler::scaling_derivative_: unknown scaling function");
+}
+// its 2nd order derivative, given x, the scaling function f and its derivative df at x
+at::Tensor Scaler::scaling_2nd_derivative_(const at::Tensor & x, const at::Tensor & f, const at::Tensor & df) const {
+    switch (type_) {
+        case Type::exp      : return (a_ * a_) * f;
+        case Type::tanh     : return -2.0 / b_ * f * df;
+        case Type::exp_power: {
+            at::Tensor inverse = 1.0 / (1.0 + x);
+            return df * (b_ * inverse - a_) - b_ * f * inverse * inverse;
+        }
+    }
+    throw std::invalid_argument("SASDIC::Scaler::scaling_2nd_derivative_: unknown scaling function");
+}
 
-// given dimensionless internal coordinates,
+// given dimensionless internal coordinates (in the last dimension),
 // return scaled dimensionless internal coordinate
 at::Tensor Scaler::operator()(const at::Tensor & DICs) const {
-    at::Tensor scaling;
-    at::Tensor x = DICs[other_];
-    if (type_ == "exp(-a*x)") {
-        scaling = at::exp(-parameters_[0] * x);
-    }
-    else if (type_ == "tanh((x-a)/b)") {
-        const double & a = parameters_[0],
-                     & b = parameters_[1];
-        scaling = at::tanh((x - a) / b);
-    }
-    else if (type_ == "exp(-a*x)*(1+x)^b") {
-        const double & a = parameters_[0],
-                     & b = parameters_[1];
-        double maximum = exp(a - b) * pow(b / a, b);
-        scaling = at::exp(-a * x) * (1.0 + x).pow(b) / maximum;
-    }
-    else throw std::invalid_argument("Unimplemented scaling function " + type_);
+    at::Tensor scaling = scaling_(DICs.select(-1, other_));
     if (self_ == other_) return scaling;
-    else                 return scaling * DICs[self_];
+    else                 return scaling * DICs.select(-1, self_);
+}
+// given dimensionless internal coordinates (in the last dimension),
+// return scaled dimensionless internal coordinate and its gradient over DICs
+std::tuple<at::Tensor, at::Tensor> Scaler::compute_SDIC_grad(const at::Tensor & DICs) const {
+    at::Tensor x = DICs.select(-1, other_);
+    at::Tensor f = scaling_(x),
+              df = scaling_derivative_(x, f);
+    at::Tensor grad = DICs.new_zeros(DICs.sizes());
+    if (self_ == other_) {
+        grad.select(-1, other_).copy_(df);
+        return std::make_tuple(f, grad);
+    }
+    at::Tensor s = DICs.select(-1, self_);
+    grad.select(-1, other_).copy_(df * s);
+    grad.select(-1, self_ ).copy_(f);
+    return std::make_tuple(f * s, grad);
+}
+// given dimensionless internal coordinates (in the last dimension),
+// return scaled dimensionless internal coordinate, its gradient and Hessian over DICs
+std::tuple<at::Tensor, at::Tensor, at::Tensor> Scaler::compute_SDIC_grad_Hess(const at::Tensor & DICs) const {
+    at::Tensor x = DICs.select(-1, other_);
+    at::Tensor  f = scaling_(x),
+               df = scaling_derivative_(x, f),
+              ddf = scaling_2nd_derivative_(x, f, df);
+    std::vector<int64_t> sizes = DICs.sizes().vec();
+    at::Tensor grad = DICs.new_zeros(sizes);
+    sizes.push_back(DICs.size(-1));
+    at::Tensor Hess = DICs.new_zeros(sizes);
+    if (self_ == other_) {
+        grad.select(-1, other_).copy_(df);
+        Hess.select(-2, other_).select(-1, other_).copy_(ddf);
+        return std::make_tuple(f, grad, Hess);
+    }
+    at::Tensor s = DICs.select(-1, self_);
+    grad.select(-1, other_).copy_(df * s);
+    grad.select(-1, self_ ).copy_(f);
+    Hess.select(-2, other_).select(-1, other_).copy_(ddf * s);
+    Hess.select(-2, other_).select(-1, self_ ).copy_(df);
+    Hess.select(-2, self_ ).select(-1, other_).copy_(df);
+    return std::make_tuple(f * s, grad, Hess);
 }
 
 } // namespace SASDIC
\ No newline at end of file
@@ -4,9 +4,22 @@
 
 namespace SASDIC {
 
+// resolve the scaling function name, check parameters_ then precompute the constants
+void Scaler2::parse_(const std::string & type) {
+    if (type == "exp[-a*(x+y)]*[(1+x)*(1+y)]^b") type_ = Type::exp_power;
+    else throw std::invalid_argument("Unimplemented scaling function " + type);
+    if (parameters_.size() < 2) throw std::invalid_argument(
+    "SASDIC::Scaler2::parse_: too few parameters for scaling function " + type);
+    a_ = parameters_[0];
+    b_ = parameters_[1];
+    // normalize to the maximum at x = y = b/a - 1
+    double maximum = exp(a_ - b_) * pow(b_ / a_, b_);
+    inverse_maximum_ = 1.0 / (maximum * maximum);
+}
+
 Scaler2::Scaler2() {}
 Scaler2::Scaler2(const size_t & _self, const size_t & _other1, const size_t & _other2, const std::string & _type, const std::vector<double> & _parameters)
-: self_(_self), other1_(_other1), other2_(_other2), type_(_type), parameters_(_parameters) {}
+: self_(_self), other1_(_other1), other2_(_other2), parameters_(_parameters) {parse_(_type);}
 // construct from an input line of "self    other    type    parameter(s)"
 Scaler2::Scaler2(const std::string & line) {
     auto strs = CL::utility::split(line);
@@ -15,31 +28,95 @@ Scaler2::Scaler2(const std::string & line) {
     self_   = std::stoul(strs[0]) - 1;
     other1_ = std::stoul(strs[1]) - 1;
     other2_ = std::stoul(strs[2]) - 1;
-    type_   = strs[3];
     parameters_.resize(strs.size() - 4);
     for (size_t i = 0; i < parameters_.size(); i++) parameters_[i] = std::stod(strs[4 + i]);
+    parse_(strs[3]);
 }
 Scaler2::~Scaler2() {}
 
 const size_t & Scaler2::self  () const {return self_  ;}
 const size_t & Scaler2::other1() const {return other1_;}
 const size_t & Scaler2::other2() const {return other2_;}
+const Scaler2::Type & Scaler2::type() const {return type_;}
+
+// the scaling function of x = DICs[other1_] and y = DICs[other2_]
+at::Tensor Scaler2::scaling_(const at::Tensor & x, const at::Tensor & y) const {
+    switch (type_) {
+        case Type::exp_power: return at::exp(-a_ * (x + y)) * ((1.0 + x) * (1.0 + y)).pow(b_) * inverse_maximum_;
+    }
+    throw std::invalid_argument("SASDIC::Scaler2::scaling_: unknown scaling function");
+}
+// its partial derivatives over x and y, given x, y and the scaling function f at (x, y)
+std::tuple<at::Tensor, at::Tensor> Scaler2::scaling_derivatives_(const at::Tensor & x, const at::Tensor & y, const at::Tensor & f) const {
+    switch (type_) {
+        case Type::exp_power: return std::make_tuple(f * (b_ / (1.0 + x) - a_), f * (b_ / (1.0 + y) - a_));
+    }
+    throw std::invalid_argument("SASDIC::Scaler2::scaling_derivatives_: unknown scaling function");
+}
+// its 2nd order partial derivatives over xx, yy, xy, given x, y and the scaling function f at (x, y)
+std::tuple<at::Tensor, at::Tensor, at::Tensor> Scaler2::scaling_2nd_derivatives_(const at::Tensor & x, const at::Tensor & y, const at::Tensor & f) const {
+    switch (type_) {
+        case Type::exp_power: {
+            at::Tensor inverse_x = 1.0 / (1.0 + x),
+                       inverse_y = 1.0 / (1.0 + y);
+            at::Tensor gx = b_ * inverse_x - a_,
+                       gy = b_ * inverse_y - a_;
+            return std::make_tuple(
+                f * (gx * gx - b_ * inverse_x * inverse_x),
+                f * (gy * gy - b_ * inverse_y * inverse_y),
+                f * gx * gy);
+        }
+    }
+    throw std::invalid_argument("SASDIC::Scaler2::scaling_2nd_derivatives_: unknown scaling function");
+}
 
-// given dimensionless internal coordinates,
+// given dimensionless internal coordinates (in the last dimension),
 // return scaled dimensionless internal coordinate
 at::Tensor Scaler2::operator()(const at::Tensor & DICs) const {
-    at::Tensor scaling;
-    at::Tensor x = DICs[other1_],
-               y = DICs[other2_];
-    if (type_ == "exp[-a*(x+y)]*[(1+x)*(1+y)]^b") {
-        const double & a = parameters_[0],
-                     & b = parameters_[1];
-        double maximum = exp(a - b) * pow(b / a, b);
-        maximum *= maximum;
-        scaling = at::exp(-a * (x + y)) * ((1.0 + x) * (1.0 + y)).pow(b) / maximum;
-    }
-    else throw std::invalid_argument("Unimplemented scaling function " + type_);
-    return scaling * DICs[self_];
+    return scaling_(DICs.select(-1, other1_), DICs.select(-1, other2_)) * DICs.select(-1, self_);
+}
+// given dimensionless internal coordinates (in the last dimension),
+// return scaled dimensionless internal coordinate and its gradient over DICs
+std::tuple<at::Tensor, at::Tensor> Scaler2::compute_SDIC_grad(const at::Tensor & DICs) const {
+    at::Tensor x = DICs.select(-1, other1_),
+               y = DICs.select(-1, other2_),
+               s = DICs.select(-1, self_  );
+    at::Tensor f = scaling_(x, y), dfdx, dfdy;
+    std::tie(dfdx, dfdy) = scaling_derivatives_(x, y, f);
+    // accumulate, since self, other1, other2 are not necessarily distinct
+    at::Tensor grad = DICs.new_zeros(DICs.sizes());
+    grad.select(-1, other1_).add_(dfdx * s);
+    grad.select(-1, other2_).add_(dfdy * s);
+    grad.select(-1, self_  ).add_(f);
+    return std::make_tuple(f * s, grad);
+}
+// given dimensionless internal coordinates (in the last dimension),
+// return scaled dimensionless internal coordinate, its gradient and Hessian over DICs
+std::tuple<at::Tensor, at::Tensor, at::Tensor> Scaler2::compute_SDIC_grad_Hess(const at::Tensor & DICs) const {
+    at::Tensor x = DICs.select(-1, other1_),
+               y = DICs.select(-1, other2_),
+               s = DICs.select(-1, self_  );
+    at::Tensor f = scaling_(x, y), dfdx, dfdy, ddfdxx, ddfdyy, ddfdxy;
+    std::tie(dfdx, dfdy) = scaling_derivatives_(x, y, f);
+    std::tie(ddfdxx, ddfdyy, ddfdxy) = scaling_2nd_derivatives_(x, y, f);
+    // accumulate, since self, other1, other2 are not necessarily distinct
+    std::vector<int64_t> sizes = DICs.sizes().vec();
+    at::Tensor grad = DICs.new_zeros(sizes);
+    grad.select(-1, other1_).add_(dfdx * s);
+    grad.select(-1, other2_).add_(dfdy * s);
+    grad.select(-1, self_  ).add_(f);
+    sizes.push_back(DICs.size(-1));
+    at::Tensor Hess = DICs.new_zeros(sizes);
+    auto element = [&](const size_t & i, const size_t & j) {return Hess.select(-2, i).select(-1, j);};
+    element(other1_, other1_).add_(ddfdxx * s);
+    element(other2_, other2_).add_(ddfdyy * s);
+    element(other1_, other2_).add_(ddfdxy * s);
+    element(other2_, other1_).add_(ddfdxy * s);
+    element(other1_, self_  ).add_(dfdx);
+    element(self_  , other1_).add_(dfdx);
+    element(other2_, self_  ).add_(dfdy);
+    element(self_  , other2_).add_(dfdy);
+    return std::make_tuple(f * s, grad, Hess);
 }
 
 } // namespace SASDIC
\ No newline at end of file
@@ -163,9 +163,83 @@ void test_Jacobian() {
     std::cout << "\nBackward propagation vs numerical Jacobian: " << difference << '\n';
 }
 
+void test_compute_SASDIC_J() {
+    SASDIC::SASDICSet set("default", "IntCoordDef", "SAS.in");
+
+    std::vector<at::Tensor> qs;
+    for (const std::string & prefix : {"E", "N", "B", "I"}) {
+        CL::chem::xyz<double> geom(prefix + ".xyz", true);
+        std::vector<double> coords = geom.coords();
+        at::Tensor r = at::from_blob(coords.data(), coords.size(), top);
+        qs.push_back(set.IntCoordSet::operator()(r));
+    }
+
+    // Analytical Jacobian vs backward propagation
+    at::Tensor q = qs[0].clone();
+    std::vector<at::Tensor> SASq, SASJ;
+    std::tie(SASq, SASJ) = set.compute_SASDIC_J(q);
+    q.set_requires_grad(true);
+    std::vector<at::Tensor> SASq_A = set(q);
+    double difference = 0.0;
+    for (size_t irred = 0; irred < SASq.size(); irred++) {
+        difference += (SASq[irred] - SASq_A[irred]).norm().item<double>();
+        for (size_t row = 0; row < SASq[irred].size(0); row++) {
+            std::vector<at::Tensor> g = torch::autograd::grad({SASq_A[irred][row]}, {q}, {}, true);
+            difference += (SASJ[irred][row] - g[0]).norm().item<double>();
+        }
+    }
+    std::cout << "\nAnalytical Jacobian vs backward propagation: " << difference << '\n';
+
+    // Batch vs one by one
+    std::vector<at::Tensor> batch_SASq, batch_SASJ;
+    std::tie(batch_SASq, batch_SASJ) = set.compute_SASDIC_J(at::stack(qs));
+    difference = 0.0;
+    for (size_t b = 0; b < qs.size(); b++) {
+        std::tie(SASq, SASJ) = set.compute_SASDIC_J(qs[b]);
+        for (size_t irred = 0; irred < SASq.size(); irred++) {
+            difference += (batch_SASq[irred][b] - SASq[irred]).norm().item<double>();
+            difference += (batch_SASJ[irred][b] - SASJ[irred]).norm().item<double>();
+        }
+    }
+    std::cout << "Batch vs one by one: " << difference << '\n';
+}
+
+void test_scaler_derivatives() {
+    std::vector<SASDIC::Scaler> scalers({
+        SASDIC::Scaler("1 1 exp(-a*x) 1.5"),
+        SASDIC::Scaler("2 1 tanh((x-a)/b) 0.75 0.25"),
+        SASDIC::Scaler("3 1 exp(-a*x)*(1+x)^b 8.5 14.9")
+    });
+    SASDIC::Scaler2 scaler2("3 1 2 exp[-a*(x+y)]*[(1+x)*(1+y)]^b 3.0 3.0");
+    at::Tensor DICs = at::tensor({0.1, -0.2, 0.3}, top);
+
+    // analytical gradient and Hessian vs finite difference of the analytical value and gradient
+    auto difference = [&](const std::function<std::tuple<at::Tensor, at::Tensor, at::Tensor>(const at::Tensor &)> & f) {
+        at::Tensor value, grad, Hess;
+        std::tie(value, grad, Hess) = f(DICs);
+        at::Tensor grad_N = DICs.new_empty(3), Hess_N = DICs.new_empty({3, 3});
+        for (size_t i = 0; i < 3; i++) {
+            at::Tensor plus = DICs.clone(), minus = DICs.clone();
+            plus[i] += 1e-5;
+            minus[i] -= 1e-5;
+            auto f_plus = f(plus), f_minus = f(minus);
+            grad_N[i] = (std::get<0>(f_plus) - std::get<0>(f_minus)) / 2e-5;
+            Hess_N.select(1, i).copy_((std::get<1>(f_plus) - std::get<1>(f_minus)) / 2e-5);
+        }
+        return (grad - grad_N).norm().item<double>() + (Hess - Hess_N).norm().item<double>();
+    };
+    double sum = 0.0;
+    for (const SASDIC::Scaler & scaler : scalers) sum += difference(
+        [&](const at::Tensor & x) {return scaler.compute_SDIC_grad_Hess(x);});
+    sum += difference([&](const at::Tensor & x) {return scaler2.compute_SDIC_grad_Hess(x);});
+    std::cout << "\nAnalytical vs numerical scaler derivatives: " << sum << '\n';
+}
+
 int main() {
     std::cout << "Correct routines should print close to 0\n";
 
     test_sasdic();
     test_Jacobian();
+    test_compute_SASDIC_J();
+    test_scaler_derivatives();
 }
\ No newline at end of file
@@ -18,6 +18,7 @@ class SAReader : public Reader {
         SAReader();
         // see the base class constructor for details of `user_list`
         // `cart2CNPI` takes in Cartesian coordinate r, returns CNPI group symmetry adapted internal coordinates and their Jacobians over r
+        // Data points are constructed in parallel, so `cart2CNPI` must be thread-safe
         SAReader(const std::vector<std::string> & user_list,
                  std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> (*_cart2CNPI)(const at::Tensor &),
                  const double& _deg_thresh=0.0001);
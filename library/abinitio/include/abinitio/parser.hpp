@@ -0,0 +1,21 @@
+#ifndef abinitio_parser_hpp
+#define abinitio_parser_hpp
+
+#include <string>
+#include <vector>
+
+namespace abinitio {
+
+// Number of lines in `file`, counted as std::getline would
+size_t count_lines(const std::string & file);
+
+// Parse every whitespace-separated token in `file` as a number in order,
+// throw std::invalid_argument naming `file` on any token that is not a number
+// If `symbols`, the first token of each nonblank line is an atomic symbol and is consumed without parsing
+// The file is memory-mapped and parsed without locale,
+// Fortran exponent markers d and D are accepted as well as e and E
+std::vector<double> read_numbers(const std::string & file, const bool & symbols = false);
+
+} // namespace abinitio
+
+#endif
\ No newline at end of file
@@ -1,10 +1,14 @@
 #ifndef abinitio_reader_hpp
 #define abinitio_reader_hpp
 
+#include <exception>
+#include <functional>
+
 #include <abinitio/geometry.hpp>
 #include <abinitio/energy.hpp>
 #include <abinitio/Hamiltonian.hpp>
 #include <abinitio/DataSet.hpp>
+#include <abinitio/parser.hpp>
 
 namespace abinitio {
 
@@ -12,6 +16,24 @@ class Reader {
     protected:
         double deg_thresh_;
         std::vector<std::string> data_directories_;
+
+        // number of atoms, 0 until the first call to `NAtoms`
+        mutable size_t NAtoms_ = 0;
+
+        // Fill the loaders of each data directory by `load` in parallel
+        // Exceptions thrown by `load` are rethrown after the parallel region
+        template <typename T> std::vector<std::vector<T>> load_directories(
+        const std::function<void(std::vector<T> &, const std::string &)> & load) const {
+            std::vector<std::vector<T>> loaderss(data_directories_.size());
+            std::vector<std::exception_ptr> errors(data_directories_.size());
+            #pragma omp parallel for schedule(dynamic)
+            for (size_t i = 0; i < data_directories_.size(); i++) {
+                try {load(loaderss[i], data_directories_[i]);}
+                catch (...) {errors[i] = std::current_exception();}
+            }
+            for (const auto & error : errors) if (error) std::rethrow_exception(error);
+            return loaderss;
+        }
     public:
         Reader();
         // User specifies a list of files or directories for data sets
@@ -36,62 +58,57 @@ class Reader {
         size_t NStates(const std::string & data_directory) const;
 
         template <typename T> void load_weight(std::vector<T> & loaders, const std::string & data_directory) const {
+            if (loaders.empty()) return;
             std::string file = data_directory + "weight.txt";
-            std::ifstream ifs; ifs.open(file);
-            if (! ifs.good()) throw CL::utility::file_error(file);
-            for (T & loader : loaders) ifs >> loader.weight;
-            ifs.close();
+            std::vector<double> numbers = read_numbers(file);
+            if (numbers.size() != loaders.size()) throw std::invalid_argument(
+            "abinitio::Reader::load_weight: " + file + " has " + std::to_string(numbers.size())
+            + " numbers rather than " + std::to_string(loaders.size()));
+            for (size_t i = 0; i < loaders.size(); i++) loaders[i].weight = numbers[i];
         }
         template <typename T> void load_geom(std::vector<T> & loaders, const std::string & data_directory) const {
+            if (loaders.empty()) return;
             std::string file = data_directory + "geom.data";
-            std::ifstream ifs; ifs.open(file);
-            if (! ifs.good()) throw CL::utility::file_error(file);
-            for (T & loader : loaders)
-            for (size_t i = 0; i < loader.geom.numel() / 3; i++) {
-                std::string symbol; ifs >> symbol;
-                double dbletemp;
-                ifs >> dbletemp; loader.geom[3 * i    ].fill_(dbletemp);
-                ifs >> dbletemp; loader.geom[3 * i + 1].fill_(dbletemp);
-                ifs >> dbletemp; loader.geom[3 * i + 2].fill_(dbletemp);
-            }
-            ifs.close();
+            // each line is an atomic symbol followed by the 3 coordinates
+            std::vector<double> numbers = read_numbers(file, true);
+            size_t cartdim = loaders[0].geom.numel();
+            if (numbers.size() != loaders.size() * cartdim) throw std::invalid_argument(
+            "abinitio::Reader::load_geom: " + file + " has " + std::to_string(numbers.size())
+            + " coordinates rather than " + std::to_string(loaders.size() * cartdim));
+            for (size_t i = 0; i < loaders.size(); i++)
+            std::memcpy(loaders[i].geom.template data_ptr<double>(), &numbers[i * cartdim], cartdim * sizeof(double));
         }
         template <typename T> void load_energy(std::vector<T> & loaders, const std::string & data_directory) const {
+            if (loaders.empty()) return;
             std::string file = data_directory + "energy.data";
-            std::ifstream ifs; ifs.open(file);
-            if (! ifs.good()) throw CL::utility::file_error(file);
-            for (T & loader : loaders)
-            for (size_t j = 0; j < loader.energy.size(0); j++) {
-                double dbletemp; ifs >> dbletemp;
-                loader.energy[j].fill_(dbletemp);
-            }
-            ifs.close();
+            std::vector<double> numbers = read_numbers(file);
+            size_t NStates = loaders[0].energy.size(0);
+            if (numbers.size() != loaders.size() * NStates) throw std::invalid_argument(
+            "abinitio::Reader::load_energy: " + file + " has " + std::to_string(numbers.size())
+            + " numbers rather than " + std::to_string(loaders.size() * NStates));
+            for (size_t i = 0; i < loaders.size(); i++)
+            std::memcpy(loaders[i].energy.template data_ptr<double>(), &numbers[i * NStates], NStates * sizeof(double));
         }
         template <typename T> void load_dH(std::vector<T> & loaders, const std::string & data_directory) const {
-            for (size_t istate = 0; istate < loaders[0].dH.size(0); istate++) {
-                std::string file = data_directory + "cartgrad-" + std::to_string(istate + 1) + ".data";
-                std::ifstream ifs; ifs.open(file);
-                if (! ifs.good()) throw CL::utility::file_error(file);
-                for (T & loader : loaders)
-                for (size_t j = 0; j < loader.geom.numel(); j++) {
-                    double dbletemp; ifs >> dbletemp;
-                    loader.dH[istate][istate][j].fill_(dbletemp);
-                }
-                ifs.close();
-                for (size_t jstate = istate + 1; jstate < loaders[0].dH.size(1); jstate++) {
-                    std::string file = data_directory + "cartgrad-" + std::to_string(istate + 1) + "-" + std::to_string(jstate + 1) + ".data";
-                    std::ifstream ifs; ifs.open(file);
-                    if (! ifs.good()) throw CL::utility::file_error(file);
-                    for (T & loader : loaders)
-                    for (size_t j = 0; j < loader.geom.numel(); j++) {
-                        double dbletemp; ifs >> dbletemp;
-                        loader.dH[istate][jstate][j].fill_(dbletemp);
-                    }
-                    ifs.close();
-                }
+            if (loaders.empty()) return;
+            size_t NStates = loaders[0].dH.size(0),
+                   cartdim = loaders[0].geom.numel();
+            // read cartgrad file into dH[istate][jstate] of each loader
+            auto load_element = [&](const std::string & file, const size_t & istate, const size_t & jstate) {
+                std::vector<double> numbers = read_numbers(file);
+                if (numbers.size() != loaders.size() * cartdim) throw std::invalid_argument(
+                "abinitio::Reader::load_dH: " + file + " has " + std::to_string(numbers.size())
+                + " numbers rather than " + std::to_string(loaders.size() * cartdim));
+                size_t offset = (istate * NStates + jstate) * cartdim;
+                for (size_t i = 0; i < loaders.size(); i++)
+                std::memcpy(loaders[i].dH.template data_ptr<double>() + offset, &numbers[i * cartdim], cartdim * sizeof(double));
+            };
+            for (size_t istate = 0; istate < NStates; istate++) {
+                load_element(data_directory + "cartgrad-" + std::to_string(istate + 1) + ".data", istate, istate);
+                for (size_t jstate = istate + 1; jstate < NStates; jstate++)
+                load_element(data_directory + "cartgrad-" + std::to_string(istate + 1) + "-" + std::to_string(jstate + 1) + ".data", istate, jstate);
             }
         }
-
         // read geometries
         std::shared_ptr<DataSet<Geometry>> read_GeomSet() const;
         // read energies
@@ -33,6 +33,10 @@ if(NOT tchem_FOUND)
     set(abinitio_CXX_FLAGS "${tchem_CXX_FLAGS}")
 endif()
 
+# dependency: OpenMP
+find_package(OpenMP REQUIRED)
+set(abinitio_CXX_FLAGS "${abinitio_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+
 # import location
 find_library(abinitio_LIBRARY abinitio PATHS "${abinitioROOT}/lib")
 set_target_properties(abinitio PROPERTIES
@@ -1,9 +1,30 @@
+#include <mutex>
+#include <unordered_map>
+
 #include <tchem/intcoord.hpp>
 
 #include <abinitio/SAgeometry.hpp>
 
 namespace abinitio {
 
+namespace {
+
+// Thousands of geometries share a handful of point group internal coordinate definitions,
+// so each definition file is parsed only once then shared by all geometries
+// The shared instances are never modified after construction
+std::shared_ptr<tchem::IC::IntCoordSet> point_IntCoordSet(const std::string & file) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<tchem::IC::IntCoordSet>> registry;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = registry.find(file);
+    if (iter != registry.end()) return iter->second;
+    auto set = std::make_shared<tchem::IC::IntCoordSet>("default", file);
+    registry[file] = set;
+    return set;
+}
+
+}
+
 SAGeometry::SAGeometry() {}
 // `cart2CNPI` takes in r, returns q and corresponding J
 SAGeometry::SAGeometry(const std::string & _path, const double & _weight, const at::Tensor & _geom,
@@ -33,11 +54,11 @@ std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> (*cart2CNPI)(const
     sqrtSQs_      .resize(n_point_irreds);
     for (size_t i = 0; i < n_point_irreds; i++) {
         at::Tensor & Q = Qs_[i], & J = JQrs_[i], & S = SQs_[i];
-        tchem::IC::IntCoordSet set("default", point_defs[i]);
-        std::tie(Q, J) = set.compute_IC_J(_geom);
+        std::shared_ptr<tchem::IC::IntCoordSet> set = point_IntCoordSet(point_defs[i]);
+        std::tie(Q, J) = set->compute_IC_J(_geom);
         point_intdims_[i] = Q.size(0);
         JQrTs_        [i] = J.transpose(0, 1);
-        C2Qs_         [i] = set.gradient_cart2int_matrix(_geom);
+        C2Qs_         [i] = set->gradient_cart2int_matrix(_geom);
         S = J.mm(J.transpose(0, 1));
         at::Tensor eigvals, eigvecs;
         std::tie(eigvals, eigvecs) = S.symeig(true);
@@ -6,6 +6,33 @@
 
 namespace abinitio {
 
+namespace {
+
+// flatten the loaders of each data directory, keeping the order
+template <typename L> std::vector<const L *> flatten(const std::vector<std::vector<L>> & loaderss) {
+    std::vector<const L *> loaders;
+    for (const auto & directory_loaders : loaderss)
+    for (const auto & loader : directory_loaders) loaders.push_back(&loader);
+    return loaders;
+}
+
+// construct a T from each loader in parallel, the i-th result comes from the i-th loader
+// exceptions are rethrown after the parallel region
+template <typename T, typename L> std::vector<std::shared_ptr<T>> construct(const std::vector<const L *> & loaders,
+std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> (*cart2CNPI)(const at::Tensor &)) {
+    std::vector<std::shared_ptr<T>> results(loaders.size());
+    std::vector<std::exception_ptr> errors(loaders.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < loaders.size(); i++) {
+        try {results[i] = std::make_shared<T>(*loaders[i], cart2CNPI);}
+        catch (...) {errors[i] = std::current_exception();}
+    }
+    for (const auto & error : errors) if (error) std::rethrow_exception(error);
+    return results;
+}
+
+}
+
 SAReader::SAReader() {}
 // see the base class constructor for details of `user_list`
 // `cart2CNPI` takes in Cartesian coordinate r, returns CNPI group symmetry adapted internal coordinates and their Jacobians over r
@@ -17,42 +44,42 @@ SAReader::~SAReader() {}
 
 // read geometries in symmetry adapted internal coordinates
 std::shared_ptr<DataSet<SAGeometry>> SAReader::read_SAGeomSet() const {
-    std::vector<std::shared_ptr<SAGeometry>> pgeoms;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<SAGeomLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms();
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim);
-        }
-        load_weight    (loaders, data_directory);
-        load_geom      (loaders, data_directory);
-        load_CNPI2point(loaders, data_directory);
-        load_pointDefs (loaders, data_directory);
-        for (const auto & loader : loaders) pgeoms.push_back(std::make_shared<SAGeometry>(loader, cart2CNPI_));
-    }
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<SAGeomLoader>> loaderss = load_directories<SAGeomLoader>(
+        [&](std::vector<SAGeomLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim);
+            }
+            load_weight    (loaders, data_directory);
+            load_geom      (loaders, data_directory);
+            load_CNPI2point(loaders, data_directory);
+            load_pointDefs (loaders, data_directory);
+        });
+    std::vector<std::shared_ptr<SAGeometry>> pgeoms = construct<SAGeometry>(flatten(loaderss), cart2CNPI_);
     std::shared_ptr<DataSet<SAGeometry>> GeomSet = std::make_shared<DataSet<SAGeometry>>(pgeoms);
     return GeomSet;
 }
 
 // read energies in symmetry adapted internal coordinates
 std::shared_ptr<DataSet<SAEnergy>> SAReader::read_SAEnergySet() const {
-    std::vector<std::shared_ptr<SAEnergy>> penergies;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<SAEnergyLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms(),
-               nstates = NStates(data_directory);
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim, nstates);
-        }
-        load_weight    (loaders, data_directory);
-        load_geom      (loaders, data_directory);
-        load_CNPI2point(loaders, data_directory);
-        load_pointDefs (loaders, data_directory);
-        load_energy    (loaders, data_directory);
-        for (auto & loader : loaders) penergies.push_back(std::make_shared<SAEnergy>(loader, cart2CNPI_));
-    }
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<SAEnergyLoader>> loaderss = load_directories<SAEnergyLoader>(
+        [&](std::vector<SAEnergyLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            size_t nstates = NStates(data_directory);
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim, nstates);
+            }
+            load_weight    (loaders, data_directory);
+            load_geom      (loaders, data_directory);
+            load_CNPI2point(loaders, data_directory);
+            load_pointDefs (loaders, data_directory);
+            load_energy    (loaders, data_directory);
+        });
+    std::vector<std::shared_ptr<SAEnergy>> penergies = construct<SAEnergy>(flatten(loaderss), cart2CNPI_);
     std::shared_ptr<DataSet<SAEnergy>> EnergySet = std::make_shared<DataSet<SAEnergy>>(penergies);
     return EnergySet;
 }
@@ -60,31 +87,34 @@ std::shared_ptr<DataSet<SAEnergy>> SAReader::read_SAEnergySet() const {
 // read Hamiltonians in symmetry adapted internal coordinates
 std::tuple<std::shared_ptr<DataSet<RegSAHam>>, std::shared_ptr<DataSet<DegSAHam>>>
 SAReader::read_SAHamSet() const {
-    std::vector<std::shared_ptr<RegSAHam>> pregs;
-    std::vector<std::shared_ptr<DegSAHam>> pdegs;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<SAHamLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms(),
-               nstates = NStates(data_directory);
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim, nstates);
-        }
-        load_weight    (loaders, data_directory);
-        load_geom      (loaders, data_directory);
-        load_CNPI2point(loaders, data_directory);
-        load_pointDefs (loaders, data_directory);
-        load_energy    (loaders, data_directory);
-        load_dH        (loaders, data_directory);
-        for (const auto & loader : loaders) {
-            if (tchem::chem::check_degeneracy(loader.energy, deg_thresh_)) {
-                pdegs.push_back(std::make_shared<DegSAHam>(loader, cart2CNPI_));
-            }
-            else {
-                pregs.push_back(std::make_shared<RegSAHam>(loader, cart2CNPI_));
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<SAHamLoader>> loaderss = load_directories<SAHamLoader>(
+        [&](std::vector<SAHamLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            size_t nstates = NStates(data_directory);
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim, nstates);
             }
+            load_weight    (loaders, data_directory);
+            load_geom      (loaders, data_directory);
+            load_CNPI2point(loaders, data_directory);
+            load_pointDefs (loaders, data_directory);
+            load_energy    (loaders, data_directory);
+            load_dH        (loaders, data_directory);
+        });
+    // classify by degeneracy first, which is cheap
+    std::vector<const SAHamLoader *> regloaders, degloaders;
+    for (const SAHamLoader * loader : flatten(loaderss)) {
+        if (tchem::chem::check_degeneracy(loader->energy, deg_thresh_)) {
+            degloaders.push_back(loader);
+        }
+        else {
+            regloaders.push_back(loader);
         }
     }
+    std::vector<std::shared_ptr<RegSAHam>> pregs = construct<RegSAHam>(regloaders, cart2CNPI_);
+    std::vector<std::shared_ptr<DegSAHam>> pdegs = construct<DegSAHam>(degloaders, cart2CNPI_);
     std::shared_ptr<DataSet<RegSAHam>> RegSet = std::make_shared<DataSet<RegSAHam>>(pregs);
     std::shared_ptr<DataSet<DegSAHam>> DegSet = std::make_shared<DataSet<DegSAHam>>(pdegs);
     return std::make_tuple(RegSet, DegSet);
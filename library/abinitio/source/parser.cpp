@@ -0,0 +1,183 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <CppLibrary/utility.hpp>
+
+#include <abinitio/parser.hpp>
+
+namespace abinitio {
+
+namespace {
+
+// A read-only memory map of a whole file
+class MappedFile {
+    private:
+        const char * data_ = nullptr;
+        size_t size_ = 0;
+    public:
+        MappedFile(const std::string & file) {
+            int fd = open(file.c_str(), O_RDONLY);
+            if (fd < 0) throw CL::utility::file_error(file);
+            struct stat status;
+            if (fstat(fd, &status) != 0) {
+                close(fd);
+                throw CL::utility::file_error(file);
+            }
+            size_ = status.st_size;
+            if (size_ > 0) {
+                void * address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) {
+                    close(fd);
+                    throw CL::utility::file_error(file);
+                }
+                madvise(address, size_, MADV_SEQUENTIAL);
+                data_ = reinterpret_cast<const char *>(address);
+            }
+            close(fd);
+        }
+        ~MappedFile() {if (data_ != nullptr) munmap(const_cast<char *>(data_), size_);}
+
+        const char * begin() const {return data_;}
+        const char * end() const {return data_ + size_;}
+        size_t size() const {return size_;}
+};
+
+inline bool is_space(const char & c) {return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';}
+inline bool is_digit(const char & c) {return c >= '0' && c <= '9';}
+
+// 10^0 to 10^22 are exactly representable by double
+const double powers_of_10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Try parsing the token [begin, end) as a number
+// Clinger's fast path: when the decimal mantissa has at most 15 significant digits
+// and the decimal exponent is within 22, both are exact doubles,
+// so a single multiplication or division is correctly rounded
+// Otherwise fall back to strtod
+bool parse_number(const char * begin, const char * end, double & x) {
+    const char * p = begin;
+    bool negative = false;
+    if (*p == '+' || *p == '-') {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int64_t significant = 0, exponent = 0;
+    bool any_digit = false;
+    for (; p < end && is_digit(*p); p++) {
+        any_digit = true;
+        if (significant < 19) {
+            mantissa = 10 * mantissa + (*p - '0');
+            if (mantissa > 0) significant++;
+        }
+        else {
+            significant++;
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        p++;
+        for (; p < end && is_digit(*p); p++) {
+            any_digit = true;
+            if (significant < 19) {
+                mantissa = 10 * mantissa + (*p - '0');
+                if (mantissa > 0) significant++;
+                exponent--;
+            }
+            else significant++;
+        }
+    }
+    if (! any_digit) return false;
+    bool exponent_marker = p < end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D');
+    if (exponent_marker) {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '+' || *p == '-')) {
+            negative_exponent = *p == '-';
+            p++;
+        }
+        if (p == end || ! is_digit(*p)) return false;
+        int64_t explicit_exponent = 0;
+        for (; p < end && is_digit(*p); p++)
+        if (explicit_exponent < 100000) explicit_exponent = 10 * explicit_exponent + (*p - '0');
+        exponent += negative_exponent ? - explicit_exponent : explicit_exponent;
+    }
+    if (p != end) return false;
+    if (significant <= 15 && exponent >= -22 && exponent <= 22) {
+        x = (double)mantissa;
+        if (exponent < 0) x /= powers_of_10[- exponent];
+        else              x *= powers_of_10[  exponent];
+        if (negative) x = - x;
+        return true;
+    }
+    // slow path, strtod does not know Fortran exponent markers
+    std::string token(begin, end);
+    for (char & c : token) if (c == 'd' || c == 'D') c = 'e';
+    x = std::strtod(token.c_str(), nullptr);
+    return true;
+}
+
+}
+
+// Number of lines in `file`, counted as std::getline would
+size_t count_lines(const std::string & file) {
+    MappedFile map(file);
+    if (map.size() == 0) return 0;
+    size_t lines = 0;
+    const char * p = map.begin();
+    while (true) {
+        const char * newline = reinterpret_cast<const char *>(std::memchr(p, '\n', map.end() - p));
+        if (newline == nullptr) break;
+        lines++;
+        p = newline + 1;
+    }
+    // the last line without a trailing newline
+    if (map.end()[-1] != '\n') lines++;
+    return lines;
+}
+
+// Parse every whitespace-separated token in `file` as a number in order
+// If `symbols`, the first token of each nonblank line is an atomic symbol and is consumed without parsing
+// The file is memory-mapped and parsed without locale,
+// Fortran exponent markers d and D are accepted as well as e and E
+std::vector<double> read_numbers(const std::string & file, const bool & symbols) {
+    MappedFile map(file);
+    std::vector<double> numbers;
+    // a number takes at least 2 characters with the separator
+    numbers.reserve(map.size() / 8);
+    const char * p = map.begin(), * end = map.end();
+    size_t line = 1;
+    bool line_start = true;
+    while (p < end) {
+        while (p < end && is_space(*p)) {
+            if (*p == '\n') {
+                line++;
+                line_start = true;
+            }
+            p++;
+        }
+        if (p == end) break;
+        const char * token = p;
+        while (p < end && ! is_space(*p)) p++;
+        if (symbols && line_start) {
+            line_start = false;
+            continue;
+        }
+        line_start = false;
+        double x;
+        if (! parse_number(token, p, x)) throw std::invalid_argument(
+        "abinitio::read_numbers: " + file + " line " + std::to_string(line) + ": "
+        + std::string(token, p) + " is not a number");
+        numbers.push_back(x);
+    }
+    return numbers;
+}
+
+} // namespace abinitio
\ No newline at end of file
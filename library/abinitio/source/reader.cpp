@@ -55,17 +55,18 @@ void Reader::pretty_print(std::ostream & stream) const {
 std::vector<size_t> Reader::NData() const {
     std::vector<size_t> NData_(data_directories_.size());
     for (size_t i = 0; i < data_directories_.size(); i++)
-    NData_[i] = CL::utility::NLines(data_directories_[i] + "energy.data");
+    NData_[i] = count_lines(data_directories_[i] + "energy.data");
     return NData_;
 }
 // number of data points in this directory
 size_t Reader::NData(const std::string & data_directory) const {
-    return CL::utility::NLines(data_directory + "energy.data");
+    return count_lines(data_directory + "energy.data");
 }
 // number of atoms constituting the molecule
+// only counted once then cached
 size_t Reader::NAtoms() const {
-    size_t NAtoms_ = CL::utility::NLines(data_directories_[0] + "geom.data")
-                   / CL::utility::NLines(data_directories_[0] + "energy.data");
+    if (NAtoms_ == 0) NAtoms_ = count_lines(data_directories_[0] + "geom.data")
+                              / count_lines(data_directories_[0] + "energy.data");
     return NAtoms_;
 }
 // number of electronic states in this directory
@@ -80,38 +81,42 @@ size_t Reader::NStates(const std::string & data_directory) const {
 
 // read geometries
 std::shared_ptr<DataSet<Geometry>> Reader::read_GeomSet() const {
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<GeomLoader>> loaderss = load_directories<GeomLoader>(
+        [&](std::vector<GeomLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim);
+            }
+            load_weight(loaders, data_directory);
+            load_geom  (loaders, data_directory);
+        });
     std::vector<std::shared_ptr<Geometry>> pgeoms;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<GeomLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms();
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim);
-        }
-        load_weight(loaders, data_directory);
-        load_geom  (loaders, data_directory);
-        for (const auto & loader : loaders) pgeoms.push_back(std::make_shared<Geometry>(loader));
-    }
+    for (const auto & loaders : loaderss)
+    for (const auto & loader : loaders) pgeoms.push_back(std::make_shared<Geometry>(loader));
     std::shared_ptr<DataSet<Geometry>> GeomSet = std::make_shared<DataSet<Geometry>>(pgeoms);
     return GeomSet;
 }
 
 // read energies
 std::shared_ptr<DataSet<Energy>> Reader::read_EnergySet() const {
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<EnergyLoader>> loaderss = load_directories<EnergyLoader>(
+        [&](std::vector<EnergyLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            size_t nstates = NStates(data_directory);
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim, nstates);
+            }
+            load_weight(loaders, data_directory);
+            load_geom  (loaders, data_directory);
+            load_energy(loaders, data_directory);
+        });
     std::vector<std::shared_ptr<Energy>> penergies;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<EnergyLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms(),
-               nstates = NStates(data_directory);
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim, nstates);
-        }
-        load_weight(loaders, data_directory);
-        load_geom  (loaders, data_directory);
-        load_energy(loaders, data_directory);
-        for (const auto & loader : loaders) penergies.push_back(std::make_shared<Energy>(loader));
-    }
+    for (const auto & loaders : loaderss)
+    for (const auto & loader : loaders) penergies.push_back(std::make_shared<Energy>(loader));
     std::shared_ptr<DataSet<Energy>> EnergySet = std::make_shared<DataSet<Energy>>(penergies);
     return EnergySet;
 }
@@ -119,26 +124,28 @@ std::shared_ptr<DataSet<Energy>> Reader::read_EnergySet() const {
 // read Hamiltonians
 std::tuple<std::shared_ptr<DataSet<RegHam>>, std::shared_ptr<DataSet<DegHam>>>
 Reader::read_HamSet() const {
+    size_t cartdim = 3 * NAtoms();
+    std::vector<std::vector<HamLoader>> loaderss = load_directories<HamLoader>(
+        [&](std::vector<HamLoader> & loaders, const std::string & data_directory) {
+            loaders.resize(NData(data_directory));
+            size_t nstates = NStates(data_directory);
+            for (auto & loader : loaders) {
+                loader.path = data_directory;
+                loader.reset(cartdim, nstates);
+            }
+            load_weight(loaders, data_directory);
+            load_geom(loaders, data_directory);
+            load_energy(loaders, data_directory);
+            load_dH(loaders, data_directory);
+        });
     std::vector<std::shared_ptr<RegHam>> pregs;
     std::vector<std::shared_ptr<DegHam>> pdegs;
-    for (const std::string & data_directory : data_directories_) {
-        std::vector<HamLoader> loaders(NData(data_directory));
-        size_t cartdim = 3 * NAtoms(),
-               nstates = NStates(data_directory);
-        for (auto & loader : loaders) {
-            loader.path = data_directory;
-            loader.reset(cartdim, nstates);
-        }
-        load_weight(loaders, data_directory);
-        load_geom(loaders, data_directory);
-        load_energy(loaders, data_directory);
-        load_dH(loaders, data_directory);
-        for (const auto & loader : loaders) {
-            if (tchem::chem::check_degeneracy(loader.energy, deg_thresh_)) {
-                pdegs.push_back(std::make_shared<DegHam>(loader));
-            } else {
-                pregs.push_back(std::make_shared<RegHam>(loader));
-            }
+    for (const auto & loaders : loaderss)
+    for (const auto & loader : loaders) {
+        if (tchem::chem::check_degeneracy(loader.energy, deg_thresh_)) {
+            pdegs.push_back(std::make_shared<DegHam>(loader));
+        } else {
+            pregs.push_back(std::make_shared<RegHam>(loader));
         }
     }
     std::shared_ptr<DataSet<RegHam>> RegSet = std::make_shared<DataSet<RegHam>>(pregs);
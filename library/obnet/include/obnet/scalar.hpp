@@ -20,9 +20,29 @@ struct scalar : torch::nn::Module {
 
     void freeze(const size_t & NLayers = -1);
 
+    // x can be a vector, or a batch of vectors stacked as rows of a matrix
     at::Tensor forward(const at::Tensor & x);
     at::Tensor operator()(const at::Tensor & x);
 
+    // return y and dy / dx in one pass without building autograd graph over x
+    std::tuple<at::Tensor, at::Tensor> forward_Jacobian(const at::Tensor & x);
+    // return y, dy / dx and d2y / dx2 in one pass without building autograd graph over x
+    std::tuple<at::Tensor, at::Tensor, at::Tensor> forward_Jacobian_Hessian(const at::Tensor & x);
+
+    // return y and dy / dc, where c = at::cat(parameters()) with each parameter flattened
+    std::tuple<at::Tensor, at::Tensor> forward_Dc(const at::Tensor & x);
+    // `JT` is the transposed Jacobian of x over some coordinate r
+    // return y, ▽y over r, dy / dc, d▽y / dc
+    std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> forward_Dc_DcDx(
+    const at::Tensor & x, const at::Tensor & JT);
+    // Products with dy / dc and d▽y / dc without forming them:
+    // return y, ▽y over r, dy / dc . v, d▽y / dc . v
+    std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> forward_Dc_DcDx_jvp(
+    const at::Tensor & x, const at::Tensor & JT, const at::Tensor & v);
+    // return w dy / dc + W . d▽y / dc, where w is a scalar and W is a vector over r
+    at::Tensor forward_Dc_DcDx_vjp(
+    const at::Tensor & x, const at::Tensor & JT, const at::Tensor & w, const at::Tensor & W);
+
     // output hidden layer values before activation to `os`
     void diagnostic(const at::Tensor & x, std::ostream & os);
 };
@@ -44,6 +44,58 @@ struct symat : torch::nn::Module {
         at::Tensor forward(const CL::utility::matrix<at::Tensor> & xs);
         at::Tensor operator()(const CL::utility::matrix<at::Tensor> & xs);
 
+        // batched version of `forward`:
+        // xs[i][j] is B x (number of input features of element ij),
+        // return B x NStates x NStates
+        at::Tensor forward_batch(const CL::utility::matrix<at::Tensor> & xs);
+
+        // JTs[i][j] is the transposed Jacobian of xs[i][j] over some coordinate r,
+        // return the symmetric matrix O and ▽O over r in one pass
+        // without building autograd graph over xs
+        // Only the "upper triangle" (i <= j) of the output is meaningful
+        std::tuple<at::Tensor, at::Tensor> forward_Jacobian(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs);
+        // batched version of `forward_Jacobian`:
+        // xs[i][j] is B x (number of input features of element ij), JTs[i][j] is B x dim(r) x (that number),
+        // return B x NStates x NStates and B x NStates x NStates x dim(r)
+        std::tuple<at::Tensor, at::Tensor> forward_batch_Jacobian(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs);
+
+        // return the symmetric matrix O, as well as the gradient and Hessian of each element over its own input,
+        // which are matrices of tensors since the input dimension varies among elements
+        // Only the "upper triangle" (i <= j) of the output is meaningful
+        std::tuple<at::Tensor, CL::utility::matrix<at::Tensor>, CL::utility::matrix<at::Tensor>> forward_Hessian(
+        const CL::utility::matrix<at::Tensor> & xs);
+
+        // Closed-form gradients over c = at::cat(elements->parameters()),
+        // without per-element autograd
+        // Only the "upper triangle" (i <= j) of the output is meaningful
+        // return O and d / dc O
+        std::tuple<at::Tensor, at::Tensor> forward_Dc(const CL::utility::matrix<at::Tensor> & xs);
+        // return O, ▽O over r, d / dc O, d / dc ▽O
+        std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> forward_Dc_DcDx(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs);
+
+        // Block-sparse versions of `forward_Dc` and `forward_Dc_DcDx`:
+        // each "upper triangle" element only depends on its own parameters,
+        // so rather than the dense d / dc O and d / dc ▽O
+        // return the derivative of each element over its own parameters, line by line as `elements`
+        std::tuple<at::Tensor, std::vector<at::Tensor>> forward_Dc_blocks(const CL::utility::matrix<at::Tensor> & xs);
+        std::tuple<at::Tensor, at::Tensor, std::vector<at::Tensor>, std::vector<at::Tensor>> forward_Dc_DcDx_blocks(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs);
+
+        // Products with d / dc O and d / dc ▽O without forming them,
+        // where v is a direction in c = at::cat(elements->parameters())
+        // Only the "upper triangle" (i <= j) of the output is meaningful
+        // return O, ▽O over r, d / dc O . v, d / dc ▽O . v
+        std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> forward_Dc_DcDx_jvp(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs, const at::Tensor & v);
+        // Only the "upper triangle" (i <= j) of w and W is read
+        // return sum over i <= j of w[i][j] d / dc O[i][j] + W[i][j] . d / dc ▽O[i][j]
+        at::Tensor forward_Dc_DcDx_vjp(
+        const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs,
+        const at::Tensor & w, const at::Tensor & W);
+
         // output hidden layer values before activation to `os`
         void diagnostic(const CL::utility::matrix<at::Tensor> & xs, std::ostream & os);
 };
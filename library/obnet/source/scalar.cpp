@@ -51,19 +51,268 @@ void scalar::freeze(const size_t & NLayers) {
     }
 }
 
+// x can be a vector, or a batch of vectors stacked as rows of a matrix
+// For a batch each layer is a single GEMM, and the output is a vector of batch size
 at::Tensor scalar::forward(const at::Tensor & x) {
-    if (x.sizes().size() != 1) throw std::invalid_argument(
-    "obnet::scalar::forward: x must be a vector");
+    if (x.sizes().size() != 1 && x.sizes().size() != 2) throw std::invalid_argument(
+    "obnet::scalar::forward: x must be a vector or a batch of vectors");
     at::Tensor y = x;
     for (size_t i = 0; i < fcs->size() - 1; i++) {
         y = fcs[i]->as<torch::nn::Linear>()->forward(y);
         y = torch::tanh(y);
     }
     y = fcs[fcs->size() - 1]->as<torch::nn::Linear>()->forward(y);
-    return y[0];
+    return y.select(-1, 0);
 }
 at::Tensor scalar::operator()(const at::Tensor & x) {return this->forward(x);}
 
+// return y and dy / dx in one pass without building autograd graph over x
+// x can be a vector, or a batch of vectors stacked as rows of a matrix
+// dy / dx = W_L . diag(1 - h_{L-1}^2) . W_{L-1} . ... . diag(1 - h_1^2) . W_1
+// where h_l is the l-th hidden layer after activation
+std::tuple<at::Tensor, at::Tensor> scalar::forward_Jacobian(const at::Tensor & x) {
+    if (x.sizes().size() != 1 && x.sizes().size() != 2) throw std::invalid_argument(
+    "obnet::scalar::forward_Jacobian: x must be a vector or a batch of vectors");
+    // forward propagation, saving the derivative of tanh
+    std::vector<at::Tensor> dtanhs(fcs->size() - 1);
+    at::Tensor y = x;
+    for (size_t i = 0; i < fcs->size() - 1; i++) {
+        y = fcs[i]->as<torch::nn::Linear>()->forward(y);
+        y = torch::tanh(y);
+        dtanhs[i] = 1.0 - y * y;
+    }
+    auto output_layer = fcs[fcs->size() - 1]->as<torch::nn::Linear>();
+    y = output_layer->forward(y);
+    // backward propagation
+    at::Tensor J = output_layer->weight[0];
+    if (x.sizes().size() == 2) J = J.repeat({x.size(0), 1});
+    for (int64_t i = fcs->size() - 2; i >= 0; i--)
+    J = at::matmul(J * dtanhs[i], fcs[i]->as<torch::nn::Linear>()->weight);
+    return std::make_tuple(y.select(-1, 0), J);
+}
+
+// return y, dy / dx and d2y / dx2 in one pass without building autograd graph over x
+// x must be a vector
+// tanh is the only nonlinearity, so
+// d2y / dx2 = sum over l of (da_l / dx)^T . diag(dy / dh_l * tanh''(a_l)) . da_l / dx
+// where a_l and h_l are the l-th hidden layer before and after activation, tanh'' = -2 h (1 - h^2)
+std::tuple<at::Tensor, at::Tensor, at::Tensor> scalar::forward_Jacobian_Hessian(const at::Tensor & x) {
+    if (x.sizes().size() != 1) throw std::invalid_argument(
+    "obnet::scalar::forward_Jacobian_Hessian: x must be a vector");
+    torch::NoGradGuard no_grad;
+    size_t NLayers = fcs->size();
+    // forward propagation
+    // hs[l] is the input of layer l, das[l] is the Jacobian of the output of layer l - 1 before activation
+    std::vector<at::Tensor> hs(NLayers), das(NLayers);
+    hs[0] = x;
+    at::Tensor dh = at::eye(x.size(0), x.options());
+    for (size_t l = 0; l < NLayers - 1; l++) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        hs[l + 1] = torch::tanh(layer->forward(hs[l]));
+        das[l + 1] = layer->weight.mm(dh);
+        dh = (1.0 - hs[l + 1] * hs[l + 1]).unsqueeze(1) * das[l + 1];
+    }
+    auto output_layer = fcs[NLayers - 1]->as<torch::nn::Linear>();
+    at::Tensor  y = output_layer->forward(hs[NLayers - 1]);
+    at::Tensor dy = output_layer->weight.mm(dh)[0];
+    // backward propagation, g = dy / dh_l
+    at::Tensor ddy = x.new_zeros({x.size(0), x.size(0)});
+    at::Tensor g = output_layer->weight[0];
+    for (int64_t l = NLayers - 1; l > 0; l--) {
+        at::Tensor dtanh = 1.0 - hs[l] * hs[l];
+        ddy += das[l].transpose(0, 1).mm((-2.0 * g * hs[l] * dtanh).unsqueeze(1) * das[l]);
+        g = fcs[l - 1]->as<torch::nn::Linear>()->weight.transpose(0, 1).mv(g * dtanh);
+    }
+    return std::make_tuple(y[0], dy, ddy);
+}
+
+// return y and dy / dc, where c = at::cat(parameters()) with each parameter flattened
+// Layer by layer backward propagation without autograd
+std::tuple<at::Tensor, at::Tensor> scalar::forward_Dc(const at::Tensor & x) {
+    if (x.sizes().size() != 1) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc: x must be a vector");
+    torch::NoGradGuard no_grad;
+    size_t NLayers = fcs->size();
+    // forward propagation, hs[l] is the input of layer l
+    std::vector<at::Tensor> hs(NLayers);
+    hs[0] = x;
+    for (size_t l = 0; l < NLayers - 1; l++)
+    hs[l + 1] = torch::tanh(fcs[l]->as<torch::nn::Linear>()->forward(hs[l]));
+    at::Tensor y = fcs[NLayers - 1]->as<torch::nn::Linear>()->forward(hs[NLayers - 1]);
+    // backward propagation, delta is dy / d(output of layer l before activation)
+    std::vector<at::Tensor> dcs;
+    at::Tensor delta = y.new_ones(1);
+    for (int64_t l = NLayers - 1; l >= 0; l--) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        if (layer->options.bias()) dcs.push_back(delta);
+        dcs.push_back(at::ger(delta, hs[l]).view(-1));
+        if (l > 0) delta = layer->weight.transpose(0, 1).mv(delta) * (1.0 - hs[l] * hs[l]);
+    }
+    std::reverse(dcs.begin(), dcs.end());
+    return std::make_tuple(y[0], at::cat(dcs));
+}
+
+// `JT` is the transposed Jacobian of x over some coordinate r
+// return y, ▽y over r, dy / dc, d▽y / dc
+// where c = at::cat(parameters()) with each parameter flattened
+// ▽y is propagated forward along with y (forward mode over r),
+// then both are propagated backward (reverse mode over c)
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> scalar::forward_Dc_DcDx(
+const at::Tensor & x, const at::Tensor & JT) {
+    if (x.sizes().size() != 1) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx: x must be a vector");
+    if (JT.sizes().size() != 2) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx: JT must be a matrix");
+    if (JT.size(1) != x.size(0)) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx: inconsistent dimension between x and JT");
+    torch::NoGradGuard no_grad;
+    size_t NLayers = fcs->size();
+    int64_t dim = JT.size(0);
+    // forward propagation
+    // hs[l] is the input of layer l, dhs[l] is its gradient over r (transposed)
+    // das[l] is the gradient of the output of layer l - 1 before activation (transposed)
+    std::vector<at::Tensor> hs(NLayers), dhs(NLayers), das(NLayers);
+    hs[0] = x;
+    dhs[0] = JT.transpose(0, 1);
+    for (size_t l = 0; l < NLayers - 1; l++) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        hs[l + 1] = torch::tanh(layer->forward(hs[l]));
+        das[l + 1] = layer->weight.mm(dhs[l]);
+        dhs[l + 1] = (1.0 - hs[l + 1] * hs[l + 1]).unsqueeze(1) * das[l + 1];
+    }
+    auto output_layer = fcs[NLayers - 1]->as<torch::nn::Linear>();
+    at::Tensor  y = output_layer->forward(hs[NLayers - 1]);
+    at::Tensor dy = output_layer->weight.mm(dhs[NLayers - 1])[0];
+    // backward propagation
+    // delta = dy / d(output of layer l before activation) = d▽y / d(its gradient)
+    // Delta = d▽y / d(output of layer l before activation) (transposed)
+    std::vector<at::Tensor> dcs, dcdys;
+    at::Tensor delta = y.new_ones(1),
+               Delta = y.new_zeros({1, dim});
+    for (int64_t l = NLayers - 1; l >= 0; l--) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        if (layer->options.bias()) {
+            dcs.push_back(delta);
+            dcdys.push_back(Delta.transpose(0, 1));
+        }
+        dcs.push_back(at::ger(delta, hs[l]).view(-1));
+        at::Tensor dcdy = delta.view({1, -1, 1}) * dhs[l].transpose(0, 1).unsqueeze(1)
+                        + Delta.transpose(0, 1).unsqueeze(2) * hs[l].view({1, 1, -1});
+        dcdys.push_back(dcdy.view({dim, -1}));
+        if (l > 0) {
+            at::Tensor dtanh = 1.0 - hs[l] * hs[l];
+            at::Tensor g = layer->weight.transpose(0, 1).mv(delta);
+            at::Tensor G = layer->weight.transpose(0, 1).mm(Delta)
+                         - 2.0 * (g * hs[l]).unsqueeze(1) * das[l];
+            delta = g * dtanh;
+            Delta = G * dtanh.unsqueeze(1);
+        }
+    }
+    std::reverse(dcs.begin(), dcs.end());
+    std::reverse(dcdys.begin(), dcdys.end());
+    return std::make_tuple(y[0], dy, at::cat(dcs), at::cat(dcdys, 1));
+}
+
+// `JT` is the transposed Jacobian of x over some coordinate r, `v` is a direction in c
+// return y, ▽y over r, dy / dc . v, d▽y / dc . v
+// where c = at::cat(parameters()) with each parameter flattened
+// y and ▽y are propagated forward along with their derivatives along v (forward mode over both r and c)
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> scalar::forward_Dc_DcDx_jvp(
+const at::Tensor & x, const at::Tensor & JT, const at::Tensor & v) {
+    if (x.sizes().size() != 1) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_jvp: x must be a vector");
+    if (JT.sizes().size() != 2) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_jvp: JT must be a matrix");
+    if (JT.size(1) != x.size(0)) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_jvp: inconsistent dimension between x and JT");
+    torch::NoGradGuard no_grad;
+    size_t NLayers = fcs->size();
+    // the part of v belonging to the next parameter
+    int64_t offset = 0;
+    auto take = [&](const at::Tensor & parameter) -> at::Tensor {
+        if (offset + parameter.numel() > v.size(0)) throw std::invalid_argument(
+        "obnet::scalar::forward_Dc_DcDx_jvp: v is shorter than the parameters");
+        at::Tensor part = v.slice(0, offset, offset + parameter.numel()).view_as(parameter);
+        offset += parameter.numel();
+        return part;
+    };
+    // h is the input of layer l, dh is its gradient over r (transposed),
+    // h_v and dh_v are their derivatives along v
+    at::Tensor h = x, dh = JT.transpose(0, 1);
+    at::Tensor h_v = x.new_zeros(h.sizes()), dh_v = x.new_zeros(dh.sizes());
+    // a is the output of layer l before activation, da is its gradient over r (transposed)
+    at::Tensor a, da, a_v, da_v;
+    for (size_t l = 0; l < NLayers; l++) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        at::Tensor weight_v = take(layer->weight);
+        a = layer->forward(h);
+        da = layer->weight.mm(dh);
+        a_v = weight_v.mv(h) + layer->weight.mv(h_v);
+        da_v = weight_v.mm(dh) + layer->weight.mm(dh_v);
+        if (layer->options.bias()) a_v = a_v + take(layer->bias);
+        if (l == NLayers - 1) break;
+        h = torch::tanh(a);
+        at::Tensor dtanh = 1.0 - h * h;
+        h_v = dtanh * a_v;
+        dh = dtanh.unsqueeze(1) * da;
+        dh_v = (-2.0 * h * h_v).unsqueeze(1) * da + dtanh.unsqueeze(1) * da_v;
+    }
+    if (offset != v.size(0)) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_jvp: v is longer than the parameters");
+    return std::make_tuple(a[0], da[0], a_v[0], da_v[0]);
+}
+
+// `JT` is the transposed Jacobian of x over some coordinate r
+// return w dy / dc + W . d▽y / dc, where w is a scalar and W is a vector over r
+// This is d / dc (w y + W . ▽y), so only W . ▽y rather than ▽y has to be propagated,
+// then both are propagated backward as in `forward_Dc_DcDx` but contracted with W
+at::Tensor scalar::forward_Dc_DcDx_vjp(
+const at::Tensor & x, const at::Tensor & JT, const at::Tensor & w, const at::Tensor & W) {
+    if (x.sizes().size() != 1) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_vjp: x must be a vector");
+    if (JT.sizes().size() != 2) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_vjp: JT must be a matrix");
+    if (JT.size(1) != x.size(0)) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_vjp: inconsistent dimension between x and JT");
+    if (W.sizes().size() != 1 || W.size(0) != JT.size(0)) throw std::invalid_argument(
+    "obnet::scalar::forward_Dc_DcDx_vjp: W must be a vector over r");
+    torch::NoGradGuard no_grad;
+    size_t NLayers = fcs->size();
+    // forward propagation
+    // hs[l] is the input of layer l, dhs[l] is W . its gradient over r
+    // das[l] is W . the gradient of the output of layer l - 1 before activation
+    std::vector<at::Tensor> hs(NLayers), dhs(NLayers), das(NLayers);
+    hs[0] = x;
+    dhs[0] = JT.transpose(0, 1).mv(W);
+    for (size_t l = 0; l < NLayers - 1; l++) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        hs[l + 1] = torch::tanh(layer->forward(hs[l]));
+        das[l + 1] = layer->weight.mv(dhs[l]);
+        dhs[l + 1] = (1.0 - hs[l + 1] * hs[l + 1]) * das[l + 1];
+    }
+    // backward propagation
+    // delta = dy / d(output of layer l before activation) = d▽y / d(its gradient)
+    // Delta = W . d▽y / d(output of layer l before activation)
+    std::vector<at::Tensor> dcs;
+    at::Tensor delta = x.new_ones(1),
+               Delta = x.new_zeros(1);
+    for (int64_t l = NLayers - 1; l >= 0; l--) {
+        auto layer = fcs[l]->as<torch::nn::Linear>();
+        if (layer->options.bias()) dcs.push_back(w * delta + Delta);
+        dcs.push_back((at::ger(delta, w * hs[l] + dhs[l]) + at::ger(Delta, hs[l])).view(-1));
+        if (l > 0) {
+            at::Tensor dtanh = 1.0 - hs[l] * hs[l];
+            at::Tensor g = layer->weight.transpose(0, 1).mv(delta);
+            at::Tensor G = layer->weight.transpose(0, 1).mv(Delta)
+                         - 2.0 * g * hs[l] * das[l];
+            delta = g * dtanh;
+            Delta = G * dtanh;
+        }
+    }
+    std::reverse(dcs.begin(), dcs.end());
+    return at::cat(dcs);
+}
+
 // output weighed features and hidden layer values before activation to `os`
 void scalar::diagnostic(const at::Tensor & x, std::ostream & os) {
     if (x.sizes().size() != 1) throw std::invalid_argument(
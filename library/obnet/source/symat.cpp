@@ -107,6 +107,273 @@ at::Tensor symat::forward(const CL::utility::matrix<at::Tensor> & xs) {
 }
 at::Tensor symat::operator()(const CL::utility::matrix<at::Tensor> & xs) {return forward(xs);}
 
+// batched version of `forward`:
+// xs[i][j] is B x (number of input features of element ij),
+// return B x NStates x NStates
+at::Tensor symat::forward_batch(const CL::utility::matrix<at::Tensor> & xs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch: xs must be an NStates_ x NStates_ matrix");
+    if (xs[0][0].sizes().size() != 2) throw std::invalid_argument(
+    "obnet::symat::forward_batch: xs elements must be batches of vectors");
+    int64_t batch_size = xs[0][0].size(0);
+    at::Tensor y = xs[0][0].new_empty({batch_size, NStates_, NStates_});
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        if (xs[i][j].size(0) != batch_size) throw std::invalid_argument(
+        "obnet::symat::forward_batch: inconsistent batch size among xs elements");
+        y.select(1, i).select(1, j).copy_(elements[count]->as<scalar>()->operator()(xs[i][j]));
+        count++;
+    }
+    return y;
+}
+
+// JTs[i][j] is the transposed Jacobian of xs[i][j] over some coordinate r,
+// return the symmetric matrix O and ▽O over r in one pass
+// without building autograd graph over xs
+// Only the "upper triangle" (i <= j) of the output is meaningful
+std::tuple<at::Tensor, at::Tensor> symat::forward_Jacobian(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Jacobian: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Jacobian: xs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Jacobian: JTs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Jacobian: JTs must be an NStates_ x NStates_ matrix");
+    at::Tensor  y = xs[0][0].new_empty({NStates_, NStates_}),
+               dy = xs[0][0].new_empty({NStates_, NStates_, JTs[0][0].size(0)});
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        at::Tensor value, gradient;
+        std::tie(value, gradient) = elements[count]->as<scalar>()->forward_Jacobian(xs[i][j]);
+         y[i][j] = value;
+        dy[i][j] = JTs[i][j].mv(gradient);
+        count++;
+    }
+    return std::make_tuple(y, dy);
+}
+
+// batched version of `forward_Jacobian`:
+// xs[i][j] is B x (number of input features of element ij), JTs[i][j] is B x dim(r) x (that number),
+// return B x NStates x NStates and B x NStates x NStates x dim(r)
+std::tuple<at::Tensor, at::Tensor> symat::forward_batch_Jacobian(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch_Jacobian: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch_Jacobian: xs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch_Jacobian: JTs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_batch_Jacobian: JTs must be an NStates_ x NStates_ matrix");
+    if (xs[0][0].sizes().size() != 2) throw std::invalid_argument(
+    "obnet::symat::forward_batch_Jacobian: xs elements must be batches of vectors");
+    int64_t batch_size = xs[0][0].size(0);
+    at::Tensor  y = xs[0][0].new_empty({batch_size, NStates_, NStates_}),
+               dy = xs[0][0].new_empty({batch_size, NStates_, NStates_, JTs[0][0].size(1)});
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        if (xs[i][j].size(0) != batch_size || JTs[i][j].size(0) != batch_size) throw std::invalid_argument(
+        "obnet::symat::forward_batch_Jacobian: inconsistent batch size among xs and JTs elements");
+        at::Tensor value, gradient;
+        std::tie(value, gradient) = elements[count]->as<scalar>()->forward_Jacobian(xs[i][j]);
+         y.select(1, i).select(1, j).copy_(value);
+        dy.select(1, i).select(1, j).copy_(at::matmul(JTs[i][j], gradient.unsqueeze(-1)).squeeze(-1));
+        count++;
+    }
+    return std::make_tuple(y, dy);
+}
+
+// return the symmetric matrix O, as well as the gradient and Hessian of each element over its own input,
+// which are matrices of tensors since the input dimension varies among elements
+// Only the "upper triangle" (i <= j) of the output is meaningful
+std::tuple<at::Tensor, CL::utility::matrix<at::Tensor>, CL::utility::matrix<at::Tensor>> symat::forward_Hessian(
+const CL::utility::matrix<at::Tensor> & xs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Hessian: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Hessian: xs must be an NStates_ x NStates_ matrix");
+    at::Tensor y = xs[0][0].new_empty({NStates_, NStates_});
+    CL::utility::matrix<at::Tensor> dys(NStates_), ddys(NStates_);
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        at::Tensor value;
+        std::tie(value, dys[i][j], ddys[i][j]) = elements[count]->as<scalar>()->forward_Jacobian_Hessian(xs[i][j]);
+        y[i][j] = value;
+        count++;
+    }
+    return std::make_tuple(y, dys, ddys);
+}
+
+// return O and d / dc O, where c = at::cat(elements->parameters()) with each parameter flattened
+// Only the "upper triangle" (i <= j) of the output is meaningful
+std::tuple<at::Tensor, at::Tensor> symat::forward_Dc(const CL::utility::matrix<at::Tensor> & xs) {
+    at::Tensor y;
+    std::vector<at::Tensor> dcs;
+    std::tie(y, dcs) = forward_Dc_blocks(xs);
+    int64_t NPars = 0;
+    for (const at::Tensor & dc : dcs) NPars += dc.size(0);
+    at::Tensor dcy = y.new_zeros({NStates_, NStates_, NPars});
+    size_t count = 0;
+    int64_t start = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        int64_t stop = start + dcs[count].size(0);
+        dcy[i][j].slice(0, start, stop).copy_(dcs[count]);
+        start = stop;
+        count++;
+    }
+    return std::make_tuple(y, dcy);
+}
+
+// JTs[i][j] is the transposed Jacobian of xs[i][j] over some coordinate r,
+// return O, ▽O over r, d / dc O, d / dc ▽O
+// where c = at::cat(elements->parameters()) with each parameter flattened
+// Only the "upper triangle" (i <= j) of the output is meaningful
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> symat::forward_Dc_DcDx(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs) {
+    at::Tensor y, dy;
+    std::vector<at::Tensor> dcs, dcdys;
+    std::tie(y, dy, dcs, dcdys) = forward_Dc_DcDx_blocks(xs, JTs);
+    int64_t NPars = 0;
+    for (const at::Tensor & dc : dcs) NPars += dc.size(0);
+    at::Tensor  dcy = y.new_zeros({NStates_, NStates_, NPars}),
+               dcdy = y.new_zeros({NStates_, NStates_, dy.size(-1), NPars});
+    size_t count = 0;
+    int64_t start = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        int64_t stop = start + dcs[count].size(0);
+         dcy[i][j].slice(0, start, stop).copy_(dcs[count]);
+        dcdy[i][j].slice(1, start, stop).copy_(dcdys[count]);
+        start = stop;
+        count++;
+    }
+    return std::make_tuple(y, dy, dcy, dcdy);
+}
+
+// return O and the derivative of each "upper triangle" element over its own parameters,
+// line by line as `elements`
+// Only the "upper triangle" (i <= j) of O is meaningful
+std::tuple<at::Tensor, std::vector<at::Tensor>> symat::forward_Dc_blocks(const CL::utility::matrix<at::Tensor> & xs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_blocks: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_blocks: xs must be an NStates_ x NStates_ matrix");
+    at::Tensor y = xs[0][0].new_empty({NStates_, NStates_});
+    std::vector<at::Tensor> dcs(elements->size());
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        at::Tensor value;
+        std::tie(value, dcs[count]) = elements[count]->as<scalar>()->forward_Dc(xs[i][j]);
+        y[i][j] = value;
+        count++;
+    }
+    return std::make_tuple(y, dcs);
+}
+
+// JTs[i][j] is the transposed Jacobian of xs[i][j] over some coordinate r,
+// return O, ▽O over r, and the derivatives of each "upper triangle" element and its ▽ over its own parameters,
+// line by line as `elements`
+// Only the "upper triangle" (i <= j) of O and ▽O is meaningful
+std::tuple<at::Tensor, at::Tensor, std::vector<at::Tensor>, std::vector<at::Tensor>> symat::forward_Dc_DcDx_blocks(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_blocks: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_blocks: xs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_blocks: JTs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_blocks: JTs must be an NStates_ x NStates_ matrix");
+    int64_t dim = JTs[0][0].size(0);
+    at::Tensor  y = xs[0][0].new_empty({NStates_, NStates_}),
+               dy = xs[0][0].new_empty({NStates_, NStates_, dim});
+    std::vector<at::Tensor> dcs(elements->size()), dcdys(elements->size());
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        at::Tensor value, gradient;
+        std::tie(value, gradient, dcs[count], dcdys[count]) = elements[count]->as<scalar>()->forward_Dc_DcDx(xs[i][j], JTs[i][j]);
+         y[i][j] = value;
+        dy[i][j] = gradient;
+        count++;
+    }
+    return std::make_tuple(y, dy, dcs, dcdys);
+}
+
+// Products with d / dc O and d / dc ▽O without forming them,
+// where v is a direction in c = at::cat(elements->parameters()) with each parameter flattened
+// Only the "upper triangle" (i <= j) of the output is meaningful
+// return O, ▽O over r, d / dc O . v, d / dc ▽O . v
+std::tuple<at::Tensor, at::Tensor, at::Tensor, at::Tensor> symat::forward_Dc_DcDx_jvp(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs, const at::Tensor & v) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_jvp: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_jvp: xs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_jvp: JTs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_jvp: JTs must be an NStates_ x NStates_ matrix");
+    int64_t dim = JTs[0][0].size(0);
+    at::Tensor    y = xs[0][0].new_empty({NStates_, NStates_}),
+                 dy = xs[0][0].new_empty({NStates_, NStates_, dim}),
+                y_v = xs[0][0].new_empty({NStates_, NStates_}),
+               dy_v = xs[0][0].new_empty({NStates_, NStates_, dim});
+    size_t count = 0;
+    int64_t offset = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        int64_t NPars = 0;
+        for (const at::Tensor & p : elements[count]->parameters()) NPars += p.numel();
+        at::Tensor value, gradient, value_v, gradient_v;
+        std::tie(value, gradient, value_v, gradient_v) = elements[count]->as<scalar>()->forward_Dc_DcDx_jvp(
+            xs[i][j], JTs[i][j], v.slice(0, offset, offset + NPars));
+           y[i][j] = value;
+          dy[i][j] = gradient;
+         y_v[i][j] = value_v;
+        dy_v[i][j] = gradient_v;
+        offset += NPars;
+        count++;
+    }
+    if (offset != v.size(0)) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_jvp: v must be as long as the parameters");
+    return std::make_tuple(y, dy, y_v, dy_v);
+}
+
+// Only the "upper triangle" (i <= j) of w and W is read
+// return sum over i <= j of w[i][j] d / dc O[i][j] + W[i][j] . d / dc ▽O[i][j]
+// where c = at::cat(elements->parameters()) with each parameter flattened
+at::Tensor symat::forward_Dc_DcDx_vjp(
+const CL::utility::matrix<at::Tensor> & xs, const CL::utility::matrix<at::Tensor> & JTs,
+const at::Tensor & w, const at::Tensor & W) {
+    if (xs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_vjp: xs must be an NStates_ x NStates_ matrix");
+    if (xs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_vjp: xs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(0) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_vjp: JTs must be an NStates_ x NStates_ matrix");
+    if (JTs.size(1) != NStates_) throw std::invalid_argument(
+    "obnet::symat::forward_Dc_DcDx_vjp: JTs must be an NStates_ x NStates_ matrix");
+    std::vector<at::Tensor> dcs(elements->size());
+    size_t count = 0;
+    for (int64_t i = 0; i < NStates_; i++)
+    for (int64_t j = i; j < NStates_; j++) {
+        dcs[count] = elements[count]->as<scalar>()->forward_Dc_DcDx_vjp(xs[i][j], JTs[i][j], w[i][j], W[i][j]);
+        count++;
+    }
+    return at::cat(dcs);
+}
+
 // output hidden layer values before activation to `os`
 void symat::diagnostic(const CL::utility::matrix<at::Tensor> & xs, std::ostream & os) {
     if (xs.size(0) != NStates_) throw std::invalid_argument(
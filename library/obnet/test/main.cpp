@@ -2,6 +2,7 @@
 
 #include <tchem/utility.hpp>
 
+#include <obnet/scalar.hpp>
 #include <obnet/symat.hpp>
 
 #include "global.hpp"
@@ -29,6 +30,126 @@ int main() {
 
     Hdnet->diagnostic(xs, std::cout);
 
+    std::vector<at::Tensor> qs_grad(qs.size());
+    for (size_t i = 0; i < qs.size(); i++) {
+        qs_grad[i] = qs[i].clone();
+        qs_grad[i].set_requires_grad(true);
+    }
+    CL::utility::matrix<at::Tensor> xs_grad = (*input_generator)(qs_grad);
+    CL::utility::matrix<at::Tensor> xs_JT(Hdnet->NStates()), JTs(Hdnet->NStates());
+    std::tie(xs_JT, JTs) = input_generator->compute_x_JT(qs);
+    at::Tensor Hd_grad = (*Hdnet)(xs_grad);
+    at::Tensor Hd_analytic, DqHd_analytic;
+    std::tie(Hd_analytic, DqHd_analytic) = Hdnet->forward_Jacobian(xs_JT, JTs);
+    double difference = 0.0;
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++) {
+        std::vector<at::Tensor> g = torch::autograd::grad({Hd_grad[i][j]}, qs_grad, {}, true, false, true);
+        for (size_t k = 0; k < g.size(); k++) if (! g[k].defined()) g[k] = qs[k].new_zeros(qs[k].sizes());
+        difference += (DqHd_analytic[i][j] - at::cat(g)).norm().item<double>();
+        difference += (Hd_analytic[i][j] - Hd_grad[i][j]).abs().item<double>();
+    }
+    std::cout << "\nAnalytic input Jacobian, should print close to 0:\n"
+              << difference << '\n';
+
+    std::vector<at::Tensor> cs = Hdnet->elements->parameters();
+    at::Tensor Hd_Dc, DqHd_Dc, DcHd, DcDqHd;
+    std::tie(Hd_Dc, DqHd_Dc, DcHd, DcDqHd) = Hdnet->forward_Dc_DcDx(xs_JT, JTs);
+    double difference_Dc = 0.0;
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++) {
+        difference_Dc += (Hd_Dc[i][j] - Hd_analytic[i][j]).abs().item<double>();
+        difference_Dc += (DqHd_Dc[i][j] - DqHd_analytic[i][j]).norm().item<double>();
+        std::vector<at::Tensor> gs = torch::autograd::grad({Hd_grad[i][j]}, cs, {}, true, false, true);
+        for (size_t l = 0; l < gs.size(); l++) gs[l] = gs[l].defined() ? gs[l].view(-1) : cs[l].new_zeros(cs[l].numel());
+        difference_Dc += (DcHd[i][j] - at::cat(gs)).norm().item<double>();
+        std::vector<at::Tensor> g = torch::autograd::grad({Hd_grad[i][j]}, qs_grad, {}, true, true, true);
+        for (size_t k = 0; k < g.size(); k++) if (! g[k].defined()) g[k] = qs[k].new_zeros(qs[k].sizes());
+        at::Tensor DqHd_ij = at::cat(g);
+        if (! DqHd_ij.requires_grad()) continue;
+        for (size_t k = 0; k < DqHd_ij.size(0); k++) {
+            gs = torch::autograd::grad({DqHd_ij[k]}, cs, {}, true, false, true);
+            for (size_t l = 0; l < gs.size(); l++) gs[l] = gs[l].defined() ? gs[l].view(-1) : cs[l].new_zeros(cs[l].numel());
+            difference_Dc += (DcDqHd[i][j][k] - at::cat(gs)).norm().item<double>();
+        }
+    }
+    std::cout << "\nClosed-form parameter gradients, should print close to 0:\n"
+              << difference_Dc << '\n';
+
+    at::Tensor v = at::rand(DcHd.size(-1), DcHd.options());
+    at::Tensor Hd_jvp, DqHd_jvp, DcHd_v, DcDqHd_v;
+    std::tie(Hd_jvp, DqHd_jvp, DcHd_v, DcDqHd_v) = Hdnet->forward_Dc_DcDx_jvp(xs_JT, JTs, v);
+    at::Tensor w = at::rand({Hdnet->NStates(), Hdnet->NStates()}, DcHd.options()),
+               W = at::rand(DqHd_analytic.sizes(), DcHd.options());
+    at::Tensor vjp = Hdnet->forward_Dc_DcDx_vjp(xs_JT, JTs, w, W);
+    at::Tensor vjp_dense = at::zeros_like(v);
+    double difference_jvp = 0.0;
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++) {
+        difference_jvp += (Hd_jvp[i][j] - Hd_analytic[i][j]).abs().item<double>();
+        difference_jvp += (DqHd_jvp[i][j] - DqHd_analytic[i][j]).norm().item<double>();
+        difference_jvp += (DcHd_v[i][j] - DcHd[i][j].dot(v)).abs().item<double>();
+        difference_jvp += (DcDqHd_v[i][j] - DcDqHd[i][j].mv(v)).norm().item<double>();
+        vjp_dense += w[i][j] * DcHd[i][j] + W[i][j].matmul(DcDqHd[i][j]);
+    }
+    difference_jvp += (vjp - vjp_dense).norm().item<double>();
+    std::cout << "\nParameter gradient products, should print close to 0:\n"
+              << difference_jvp << '\n';
+
+    at::Tensor Hd_Hess;
+    CL::utility::matrix<at::Tensor> dxHds(Hdnet->NStates()), ddxHds(Hdnet->NStates());
+    std::tie(Hd_Hess, dxHds, ddxHds) = Hdnet->forward_Hessian(xs);
+    double difference_Hess = 0.0;
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++) {
+        difference_Hess += (Hd_Hess[i][j] - Hd_analytic[i][j]).abs().item<double>();
+        at::Tensor x = xs[i][j].clone();
+        x.set_requires_grad(true);
+        at::Tensor y = (*Hdnet->elements[(2 * Hdnet->NStates() - i + 1) * i / 2 + j - i]->as<obnet::scalar>())(x);
+        at::Tensor g = torch::autograd::grad({y}, {x}, {}, true, true)[0];
+        difference_Hess += (dxHds[i][j] - g).norm().item<double>();
+        for (size_t k = 0; k < x.size(0); k++) {
+            at::Tensor h = torch::autograd::grad({g[k]}, {x}, {}, true, false, true)[0];
+            if (! h.defined()) h = x.new_zeros(x.sizes());
+            difference_Hess += (ddxHds[i][j][k] - h).norm().item<double>();
+        }
+    }
+    std::cout << "\nAnalytic input Hessian, should print close to 0:\n"
+              << difference_Hess << '\n';
+
+    CL::utility::matrix<at::Tensor> xs_batch(Hdnet->NStates());
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++)
+    xs_batch[i][j] = at::stack({xs[i][j], 0.5 * xs[i][j]});
+    at::Tensor Hd_batch = Hdnet->forward_batch(xs_batch);
+    CL::utility::matrix<at::Tensor> xs_half(Hdnet->NStates());
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++)
+    xs_half[i][j] = 0.5 * xs[i][j];
+    at::Tensor Hd_half = (*Hdnet)(xs_half);
+    std::cout << "\nBatched forward, should print close to 0:\n"
+              << (Hd_batch[0] - Hd).triu().norm().item<double>() << ' '
+              << (Hd_batch[1] - Hd_half).triu().norm().item<double>() << '\n';
+
+    CL::utility::matrix<at::Tensor> JTs_batch(Hdnet->NStates());
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++)
+    JTs_batch[i][j] = at::stack({JTs[i][j], JTs[i][j]});
+    at::Tensor Hd_batch_Jacobian, DqHd_batch;
+    std::tie(Hd_batch_Jacobian, DqHd_batch) = Hdnet->forward_batch_Jacobian(xs_batch, JTs_batch);
+    at::Tensor Hd_half_Jacobian, DqHd_half;
+    std::tie(Hd_half_Jacobian, DqHd_half) = Hdnet->forward_Jacobian(xs_half, JTs);
+    double difference_batch = 0.0;
+    for (size_t i = 0; i < Hdnet->NStates(); i++)
+    for (size_t j = i; j < Hdnet->NStates(); j++) {
+        difference_batch += (Hd_batch_Jacobian[0][i][j] - Hd_analytic[i][j]).abs().item<double>()
+                          + (Hd_batch_Jacobian[1][i][j] - Hd_half_Jacobian[i][j]).abs().item<double>();
+        difference_batch += (DqHd_batch[0][i][j] - DqHd_analytic[i][j]).norm().item<double>()
+                          + (DqHd_batch[1][i][j] - DqHd_half[i][j]).norm().item<double>();
+    }
+    std::cout << "\nBatched Jacobian, should print close to 0:\n"
+              << difference_batch << '\n';
+
     std::cout << "Number of parameters = "
               << tchem::utility::NParameters(Hdnet->elements->parameters())
               << '\n';
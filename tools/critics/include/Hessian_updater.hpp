@@ -0,0 +1,38 @@
+#ifndef Hessian_updater_hpp
+#define Hessian_updater_hpp
+
+#include <functional>
+
+#include <torch/torch.h>
+
+// Keep a Hessian approximation across the Hessian callbacks of an optimizer:
+// the exact Hessian is only computed every `exact_interval` requests,
+// in between it is propagated from the gradients by a quasi-Newton update
+class Hessian_updater {
+    public:
+        enum class Formula {BFGS, Bofill};
+    private:
+        Formula formula_;
+        size_t exact_interval_;
+
+        size_t count_ = 0;
+        // point, gradient and Hessian (approximation) at the last request
+        at::Tensor x_, g_, H_;
+
+        void BFGS_  (const at::Tensor & s, const at::Tensor & y);
+        void Bofill_(const at::Tensor & s, const at::Tensor & y);
+    public:
+        Hessian_updater();
+        Hessian_updater(const Formula & _formula, const size_t & _exact_interval);
+        ~Hessian_updater();
+
+        // forget the history, e.g. when the objective function changes
+        void reset();
+
+        // x: current point
+        // g: gradient at x
+        // exact: computes the exact Hessian at x
+        at::Tensor operator()(const at::Tensor & x, const at::Tensor & g, const std::function<at::Tensor()> & exact);
+};
+
+#endif
\ No newline at end of file
@@ -11,9 +11,17 @@ extern std::shared_ptr<tchem::IC::IntCoordSet> intcoordset;
 
 extern std::shared_ptr<Hd::Kernel> HdKernel;
 
-extern std::shared_ptr<Fixed_intcoord> fixed_intcoord;
+// thread local, so each concurrent search can fix its own coordinates
+extern thread_local std::shared_ptr<Fixed_intcoord> fixed_intcoord;
+
+// the exact Hessian is recomputed every this many Hessian requests,
+// in between it is approximated by quasi-Newton updates
+extern size_t exact_Hessian_interval;
 
 at::Tensor int2cart(const at::Tensor & q, const at::Tensor & init_guess,
 const std::shared_ptr<tchem::IC::IntCoordSet> & _intcoordset);
 
+// int2cart warm starts from the last solution on the calling thread, this forgets it
+void reset_int2cart();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <sstream>
+
+#include <CppLibrary/utility.hpp>
+#include <CppLibrary/chemistry.hpp>
+
+#include "../include/global.hpp"
+#include "../include/Hd_extension.hpp"
+
+at::Tensor search_minimum_adiabatic(const at::Tensor& init_guess, const int64_t& target_state);
+at::Tensor search_minimum_diabatic (const at::Tensor& init_guess, const int64_t& target_state);
+
+at::Tensor search_saddle_adiabatic(const at::Tensor& init_guess, const int64_t& target_state);
+at::Tensor search_saddle_diabatic (const at::Tensor& init_guess, const int64_t& target_state);
+
+at::Tensor search_mex_adiabatic(const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2, std::ostream & os);
+at::Tensor search_mex_diabatic (const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2, std::ostream & os);
+
+namespace {
+
+// a manifest line reads
+//     job  xyz  representation  target  [target2, mex only]  [fixed coordinates]
+// where representation = adiabatic or diabatic, indices start from 1
+struct Task {
+    std::string job, xyz;
+    bool adiabatz;
+    int64_t target_state, target_state2 = -1;
+    std::vector<size_t> fixed_coords;
+
+    std::vector<std::string> symbols;
+    at::Tensor init_r;
+};
+
+int64_t read_state(const std::string & str, const std::string & line) {
+    int64_t state = std::stol(str);
+    if (state < 1 || HdKernel->NStates() < state) throw std::invalid_argument(
+    "read_manifest: target state out of range [1, " + std::to_string(HdKernel->NStates()) + "] in line: " + line);
+    return state - 1;
+}
+
+std::vector<Task> read_manifest(const std::string & manifest) {
+    std::ifstream ifs; ifs.open(manifest);
+    if (! ifs.good()) throw CL::utility::file_error(manifest);
+    std::vector<Task> tasks;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::vector<std::string> strs = CL::utility::split(line.substr(0, line.find('#')));
+        if (strs.empty()) continue;
+        if (strs.size() < 4) throw std::invalid_argument("read_manifest: too few columns in line: " + line);
+        Task task;
+        task.job = strs[0];
+        if (task.job != "min" && task.job != "sad" && task.job != "mex") throw std::invalid_argument(
+        "read_manifest: unsupported job type in line: " + line);
+        task.xyz = strs[1];
+        if      (strs[2] == "adiabatic") task.adiabatz = true;
+        else if (strs[2] == "diabatic" ) task.adiabatz = false;
+        else throw std::invalid_argument("read_manifest: representation must be adiabatic or diabatic in line: " + line);
+        task.target_state = read_state(strs[3], line);
+        size_t start = 4;
+        if (task.job == "mex") {
+            if (strs.size() < 5) throw std::invalid_argument("read_manifest: mex requires target2 in line: " + line);
+            task.target_state2 = read_state(strs[4], line);
+            start = 5;
+        }
+        for (size_t i = start; i < strs.size(); i++) task.fixed_coords.push_back(std::stoul(strs[i]) - 1);
+        CL::chem::xyz<double> init_geom(task.xyz, true);
+        task.symbols = init_geom.symbols();
+        std::vector<double> init_coords = init_geom.coords();
+        task.init_r = at::from_blob(init_coords.data(), init_coords.size(), at::TensorOptions().dtype(torch::kFloat64)).clone();
+        tasks.push_back(task);
+    }
+    ifs.close();
+    return tasks;
+}
+
+// Foptim (BFGS, Gauss_BFGS, trust_region) is not known to be reentrant, so the searches run one at a time,
+// each parallelized inside by the Hd kernel and libtorch
+// int2cart warm starts from the last solution, which belongs to the previous task
+at::Tensor search(const Task & task, std::ostream & os) {
+    reset_int2cart();
+    at::Tensor init_q = (*intcoordset)(task.init_r);
+    fixed_intcoord = std::make_shared<Fixed_intcoord>(intcoordset->size(), task.fixed_coords, init_q);
+    if (task.adiabatz) {
+        if      (task.job == "min") return search_minimum_adiabatic(task.init_r, task.target_state);
+        else if (task.job == "sad") return search_saddle_adiabatic (task.init_r, task.target_state);
+        else                        return search_mex_adiabatic    (task.init_r, task.target_state, task.target_state2, os);
+    }
+    else {
+        if      (task.job == "min") return search_minimum_diabatic(task.init_r, task.target_state);
+        else if (task.job == "sad") return search_saddle_diabatic (task.init_r, task.target_state);
+        else                        return search_mex_diabatic    (task.init_r, task.target_state, task.target_state2, os);
+    }
+}
+
+// a distinct critical geometry and the tasks converging to it
+struct Critic {
+    size_t task;
+    at::Tensor r, q, energy;
+    std::vector<size_t> found_by;
+};
+
+bool same_kind(const Task & a, const Task & b) {
+    return a.job == b.job && a.adiabatz == b.adiabatz
+        && a.target_state == b.target_state && a.target_state2 == b.target_state2;
+}
+
+}
+
+// run the searches listed in manifest,
+// then merge those converging to a same geometry (internal coordinate difference < threshold)
+void run_batch(const std::string & manifest, const double & threshold, const std::string & output) {
+    std::vector<Task> tasks = read_manifest(manifest);
+    std::cout << "Number of search tasks = " << tasks.size() << '\n';
+
+    // each task reports its progress to its own stream, printed once the task is over
+    std::vector<at::Tensor> final_rs(tasks.size());
+    std::vector<std::string> errors(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        std::ostringstream progress;
+        try {
+            final_rs[i] = search(tasks[i], progress);
+        }
+        catch (const std::exception & e) {
+            errors[i] = e.what();
+        }
+        std::cout << "\nTask " << i + 1 << ' ' << tasks[i].job << ' ' << tasks[i].xyz << ":\n"
+                  << progress.str();
+        if (errors[i].empty()) std::cout << "Task " << i + 1 << " is done\n";
+        else                   std::cout << "Task " << i + 1 << " failed: " << errors[i] << '\n';
+    }
+
+    // the converged geometries are characterized in parallel, since the Hd kernel is thread safe
+    std::vector<at::Tensor> final_qs(tasks.size()), energies(tasks.size());
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < tasks.size(); i++)
+    if (final_rs[i].defined()) {
+        final_qs[i] = (*intcoordset)(final_rs[i]);
+        energies[i] = tasks[i].adiabatz ? compute_energy(final_rs[i]) : (*HdKernel)(final_rs[i]).diagonal();
+    }
+
+    std::vector<Critic> critics;
+    for (size_t i = 0; i < tasks.size(); i++) {
+        if (! final_rs[i].defined()) continue;
+        bool duplicate = false;
+        for (Critic & critic : critics)
+        if (same_kind(tasks[critic.task], tasks[i]) && (critic.q - final_qs[i]).norm().item<double>() < threshold) {
+            critic.found_by.push_back(i);
+            duplicate = true;
+            break;
+        }
+        if (duplicate) continue;
+        critics.push_back({i, final_rs[i], final_qs[i], energies[i], {i}});
+    }
+
+    std::ofstream ofs; ofs.open(output);
+    ofs << "# critical geometries found by critics from " << manifest << '\n'
+        << "# file, job, representation, target state(s), energy(ies), manifest tasks converging here\n";
+    std::vector<size_t> counts = {0, 0, 0};
+    for (const Critic & critic : critics) {
+        const Task & task = tasks[critic.task];
+        size_t & count = task.job == "min" ? counts[0] : task.job == "sad" ? counts[1] : counts[2];
+        count++;
+        std::string file = task.job + "-" + std::to_string(count) + ".xyz";
+        std::vector<double> coords(critic.r.size(0));
+        std::memcpy(coords.data(), critic.r.data_ptr<double>(), coords.size() * sizeof(double));
+        CL::chem::xyz<double> geom(task.symbols, coords, true);
+        geom.print(file);
+        ofs << file << "    " << task.job << "    " << (task.adiabatz ? "adiabatic" : "diabatic") << "    "
+            << task.target_state + 1;
+        if (task.job == "mex") ofs << ' ' << task.target_state2 + 1;
+        ofs << "    " << std::scientific << std::setprecision(15) << critic.energy[task.target_state].item<double>();
+        if (task.job == "mex") ofs << ' ' << critic.energy[task.target_state2].item<double>();
+        ofs << "   ";
+        for (const size_t & i : critic.found_by) ofs << ' ' << i + 1;
+        ofs << '\n';
+    }
+    for (size_t i = 0; i < tasks.size(); i++)
+    if (! errors[i].empty()) ofs << "# task " << i + 1 << " failed: " << errors[i] << '\n';
+    ofs.close();
+
+    std::cout << critics.size() << " distinct critical geometries are found, summarized in " << output << '\n';
+}
\ No newline at end of file
@@ -10,8 +10,10 @@ at::Tensor search_minimum_diabatic (const at::Tensor& init_guess, const int64_t&
 at::Tensor search_saddle_adiabatic(const at::Tensor& init_guess, const int64_t& target_state);
 at::Tensor search_saddle_diabatic (const at::Tensor& init_guess, const int64_t& target_state);
 
-at::Tensor search_mex_adiabatic(const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2);
-at::Tensor search_mex_diabatic (const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2);
+at::Tensor search_mex_adiabatic(const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2, std::ostream & os = std::cout);
+at::Tensor search_mex_diabatic (const at::Tensor& init_guess, const int64_t& target_state, const int64_t& target_state2, std::ostream & os = std::cout);
+
+void run_batch(const std::string & manifest, const double & threshold, const std::string & output);
 
 argparse::ArgumentParser parse_args(const size_t & argc, const char ** & argv) {
     CL::utility::echo_command(argc, argv, std::cout);
@@ -19,18 +21,25 @@ argparse::ArgumentParser parse_args(const size_t & argc, const char ** & argv) {
     argparse::ArgumentParser parser("Critics: a critical geometry searcher");
 
     // required arguments
-    parser.add_argument("-j","--job",        1, false, "job type: min, sad, mex");
     parser.add_argument("-f","--format",     1, false, "internal coordinate definition format (Columbus7, default)");
     parser.add_argument("-i","--IC",         1, false, "internal coordinate definition file");
-    parser.add_argument("-t","--target",     1, false, "search for min and sad on the target electronic state, index starts from 1");
     parser.add_argument("-d","--diabatz",  '+', false, "diabatz definition files");
-    parser.add_argument("-x","--xyz",        1, false, "initial guess xyz geometry file");
+
+    // required arguments for a single search
+    parser.add_argument("-j","--job",        1, true, "job type: min, sad, mex");
+    parser.add_argument("-t","--target",     1, true, "search for min and sad on the target electronic state, index starts from 1");
+    parser.add_argument("-x","--xyz",        1, true, "initial guess xyz geometry file");
+
+    // batch mode
+    parser.add_argument("-m","--manifest",            1, true, "run the searches listed in this file instead of a single search, see README for format");
+    parser.add_argument("--duplicate_threshold",      1, true, "batch mode merges geometries closer than this in internal coordinate, default = 1e-3");
 
     // optional arguments
     parser.add_argument("-a","--adiabatz", (char)0, true, "use adiabatic rather than diabatic representation");
     parser.add_argument("--target2",             1, true, "search for mex between target and target2, required for mex job");
     parser.add_argument("-c","--fixed_coords", '+', true, "fix these internal coordinates during searching");
-    parser.add_argument("-o","--output",         1, true, "output file, default = job.xyz");
+    parser.add_argument("-o","--output",         1, true, "output file, default = job.xyz, or batch.txt for batch mode");
+    parser.add_argument("--exact_Hessian_interval", 1, true, "recompute the exact Hessian every this many Hessian requests and update it in between, default = 5 (1 = always exact); minimum and mex searches request the Hessian only every 20 BFGS iterations, so there the exact Hessian comes every 20 x this many iterations");
 
     parser.parse_args(argc, argv);
     return parser;
@@ -43,13 +52,36 @@ int main(size_t argc, const char ** argv) {
     CL::utility::show_time(std::cout);
     std::cout << '\n';
 
-    std::string job = args.retrieve<std::string>("job");
-    std::cout << "Job type: " + job << '\n';
-
     std::string format = args.retrieve<std::string>("format");
     std::string IC     = args.retrieve<std::string>("IC");
     intcoordset = std::make_shared<tchem::IC::IntCoordSet>(format, IC);
 
+    std::vector<std::string> diabatz_inputs = args.retrieve<std::vector<std::string>>("diabatz");
+    HdKernel = std::make_shared<Hd::Kernel>(diabatz_inputs);
+
+    if (args.gotArgument("exact_Hessian_interval")) {
+        exact_Hessian_interval = args.retrieve<size_t>("exact_Hessian_interval");
+        if (exact_Hessian_interval < 1) throw std::invalid_argument("exact Hessian interval must be positive");
+    }
+    std::cout << "The exact Hessian is recomputed every " << exact_Hessian_interval << " Hessian requests\n";
+
+    if (args.gotArgument("manifest")) {
+        double threshold = 1e-3;
+        if (args.gotArgument("duplicate_threshold")) threshold = args.retrieve<double>("duplicate_threshold");
+        std::string output = "batch.txt";
+        if (args.gotArgument("output")) output = args.retrieve<std::string>("output");
+        run_batch(args.retrieve<std::string>("manifest"), threshold, output);
+        std::cout << '\n';
+        CL::utility::show_time(std::cout);
+        std::cout << "Mission success\n";
+        return 0;
+    }
+    if (! args.gotArgument("job") || ! args.gotArgument("target") || ! args.gotArgument("xyz"))
+    throw std::invalid_argument("job, target and xyz are required unless a manifest is given");
+
+    std::string job = args.retrieve<std::string>("job");
+    std::cout << "Job type: " + job << '\n';
+
     int64_t target_state = args.retrieve<int64_t>("target");
     std::cout << "The target electronic state is " << target_state << '\n';
     if (target_state < 1 || HdKernel->NStates() < target_state) {
@@ -71,9 +103,6 @@ int main(size_t argc, const char ** argv) {
         target_state2 -= 1;
     }
 
-    std::vector<std::string> diabatz_inputs = args.retrieve<std::vector<std::string>>("diabatz");
-    HdKernel = std::make_shared<Hd::Kernel>(diabatz_inputs);
-
     std::string guess_file = args.retrieve<std::string>("xyz");
     CL::chem::xyz<double> init_geom(guess_file, true);
     std::vector<double> init_coords = init_geom.coords();
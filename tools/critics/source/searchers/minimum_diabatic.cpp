@@ -2,11 +2,14 @@
 
 #include "../../include/global.hpp"
 #include "../../include/Hd_extension.hpp"
+#include "../../include/Hessian_updater.hpp"
 
 namespace {
 
-at::Tensor init_guess_;
-int64_t target_state_;
+thread_local at::Tensor init_guess_;
+thread_local int64_t target_state_;
+
+thread_local Hessian_updater Hessian_updater_;
 
 void energy(double & energy, const double * free_intgeom, const int32_t & free_intdim) {
     at::Tensor q_free = at::from_blob(const_cast<double *>(free_intgeom), free_intdim,
@@ -37,9 +40,13 @@ void Hessian(double * Hessian, const double * free_intgeom, const int32_t & free
     at::Tensor r = int2cart(q, init_guess_, intcoordset);
     at::Tensor Hd, dHd;
     std::tie(Hd, dHd) = HdKernel->compute_Hd_dHd(r);
-    at::Tensor cartHess = compute_ddHd(r)[target_state_][target_state_];
-    at::Tensor intHess = intcoordset->Hessian_cart2int(r, dHd[target_state_][target_state_], cartHess);
-    at::Tensor free_intHess = fixed_intcoord->matrix_total2free(intHess);
+    at::Tensor intgrad = intcoordset->gradient_cart2int(r, dHd[target_state_][target_state_]);
+    at::Tensor free_intgrad = fixed_intcoord->vector_total2free(intgrad);
+    at::Tensor free_intHess = Hessian_updater_(q_free, free_intgrad, [&]() -> at::Tensor {
+        at::Tensor cartHess = compute_ddHd(r)[target_state_][target_state_];
+        at::Tensor intHess = intcoordset->Hessian_cart2int(r, dHd[target_state_][target_state_], cartHess);
+        return fixed_intcoord->matrix_total2free(intHess);
+    });
     std::memcpy(Hessian, free_intHess.data_ptr<double>(), free_intdim * free_intdim * sizeof(double));
 }
 
@@ -48,6 +55,7 @@ void Hessian(double * Hessian, const double * free_intgeom, const int32_t & free
 at::Tensor search_minimum_diabatic(const at::Tensor& _init_guess, const int64_t& _target_state) {
     init_guess_ = _init_guess;
     target_state_ = _target_state;
+    Hessian_updater_ = Hessian_updater(Hessian_updater::Formula::BFGS, exact_Hessian_interval);
     at::Tensor q = (*intcoordset)(_init_guess);
     at::Tensor q_free = fixed_intcoord->vector_total2free(q);
     Foptim::BFGS(energy, energy_grad, Hessian,
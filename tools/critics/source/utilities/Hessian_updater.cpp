@@ -0,0 +1,60 @@
+#include "../../include/Hessian_updater.hpp"
+
+Hessian_updater::Hessian_updater() {}
+Hessian_updater::Hessian_updater(const Formula & _formula, const size_t & _exact_interval)
+: formula_(_formula), exact_interval_(_exact_interval) {
+    if (_exact_interval < 1) throw std::invalid_argument(
+    "Hessian_updater::Hessian_updater: exact Hessian interval must be positive");
+}
+Hessian_updater::~Hessian_updater() {}
+
+// B += y.y^T / y^T.s - B.s.s^T.B / s^T.B.s
+// skipped when the curvature condition fails, so B stays positive definite,
+// or when s^T.B.s is not safely positive, e.g. the exact Hessian at the last refresh is indefinite
+void Hessian_updater::BFGS_(const at::Tensor & s, const at::Tensor & y) {
+    double ys = y.dot(s).item<double>();
+    if (ys <= 1e-10 * y.norm().item<double>() * s.norm().item<double>()) return;
+    at::Tensor Bs = H_.mv(s);
+    double sBs = s.dot(Bs).item<double>();
+    if (sBs <= 1e-10 * s.dot(s).item<double>()) return;
+    H_ = H_ + y.outer(y) / ys - Bs.outer(Bs) / sBs;
+}
+
+// B += phi * SR1 + (1 - phi) * PSB, phi = (xi^T.s)^2 / (xi^T.xi) / (s^T.s), xi = y - B.s
+// the update of choice for transition states since B may be indefinite
+void Hessian_updater::Bofill_(const at::Tensor & s, const at::Tensor & y) {
+    at::Tensor xi = y - H_.mv(s);
+    double xis = xi.dot(s).item<double>(),
+           xixi = xi.dot(xi).item<double>(),
+           ss = s.dot(s).item<double>();
+    if (xixi < 1e-20) return;
+    double phi = xis * xis / xixi / ss;
+    at::Tensor PSB = (xi.outer(s) + s.outer(xi)) / ss - xis / (ss * ss) * s.outer(s);
+    if (phi > 1e-8) H_ = H_ + phi * xi.outer(xi) / xis + (1.0 - phi) * PSB;
+    else            H_ = H_ + PSB;
+}
+
+void Hessian_updater::reset() {
+    count_ = 0;
+    x_ = at::Tensor();
+    g_ = at::Tensor();
+    H_ = at::Tensor();
+}
+
+at::Tensor Hessian_updater::operator()(const at::Tensor & x, const at::Tensor & g, const std::function<at::Tensor()> & exact) {
+    if (count_ % exact_interval_ == 0 || ! H_.defined()) {
+        H_ = exact();
+    }
+    else {
+        at::Tensor s = x - x_,
+                   y = g - g_;
+        if (s.norm().item<double>() > 1e-12) {
+            if (formula_ == Formula::BFGS) BFGS_(s, y);
+            else                           Bofill_(s, y);
+        }
+    }
+    count_++;
+    x_ = x.clone();
+    g_ = g.clone();
+    return H_;
+}
\ No newline at end of file
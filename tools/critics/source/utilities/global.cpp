@@ -4,4 +4,6 @@ std::shared_ptr<tchem::IC::IntCoordSet> intcoordset;
 
 std::shared_ptr<Hd::Kernel> HdKernel;
 
-std::shared_ptr<Fixed_intcoord> fixed_intcoord;
\ No newline at end of file
+thread_local std::shared_ptr<Fixed_intcoord> fixed_intcoord;
+
+size_t exact_Hessian_interval = 5;
\ No newline at end of file
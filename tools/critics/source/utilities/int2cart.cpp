@@ -4,9 +4,13 @@
 
 namespace {
 
-std::shared_ptr<tchem::IC::IntCoordSet> intcoordset_;
+thread_local std::shared_ptr<tchem::IC::IntCoordSet> intcoordset_;
 
-at::Tensor target_intgeom_;
+thread_local at::Tensor target_intgeom_;
+
+// the last solution, which is the best initial guess for the next one
+// since optimizers request nearby (or even identical) internal coordinates
+thread_local at::Tensor last_intgeom_, last_cartgeom_;
 
 void cart2int_residue(double * residue, const double * cartgeom, const int32_t & fake_intdim, const int32_t & cartdim) {
     c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
@@ -43,15 +47,45 @@ void cart2int_Jacobian(double * JT, const double * cartgeom, const int32_t & fak
 
 at::Tensor int2cart(const at::Tensor & q, const at::Tensor & init_guess,
 const std::shared_ptr<tchem::IC::IntCoordSet> & _intcoordset) {
+    bool warm = _intcoordset == intcoordset_
+             && last_cartgeom_.defined() && last_cartgeom_.sizes() == init_guess.sizes();
     intcoordset_ = _intcoordset;
+    if (warm && at::equal(q, last_intgeom_)) return last_cartgeom_.clone();
     target_intgeom_ = q;
-    at::Tensor r = init_guess.clone();
-    double * r_ptr = r.data_ptr<double>();
-    int32_t cartdim = r.size(0),
+    int32_t cartdim = init_guess.size(0),
             intdim = intcoordset_->size();
     int32_t fake_intdim = cartdim > intdim ? cartdim : intdim;
-    Foptim::trust_region(cart2int_residue, cart2int_Jacobian, r_ptr,
-                         fake_intdim, cartdim,
-                         100, 100, 1e-12, 1e-15);
+    auto solve = [&](const at::Tensor & guess) -> at::Tensor {
+        at::Tensor r = guess.clone();
+        Foptim::trust_region(cart2int_residue, cart2int_Jacobian, r.data_ptr<double>(),
+                             fake_intdim, cartdim,
+                             100, 100, 1e-12, 1e-15);
+        return r;
+    };
+    auto residue = [&](const at::Tensor & r) -> double {
+        return ((*intcoordset_)(r) - q).norm().item<double>();
+    };
+    at::Tensor r;
+    if (warm) {
+        r = solve(last_cartgeom_);
+        // the warm start went astray if it did not converge relative to the target,
+        // then also try the user initial guess and keep the better solution
+        double warm_residue = residue(r);
+        if (warm_residue > 1e-8 * (1.0 + q.norm().item<double>())) {
+            at::Tensor r_cold = solve(init_guess);
+            if (residue(r_cold) < warm_residue) r = r_cold;
+        }
+    }
+    else r = solve(init_guess);
+    last_intgeom_  = q.clone();
+    last_cartgeom_ = r.clone();
     return r;
 }
+
+// forget the last solution, so an unrelated search on this thread starts from its own initial guess
+void reset_int2cart() {
+    intcoordset_ = nullptr;
+    target_intgeom_ = at::Tensor();
+    last_intgeom_   = at::Tensor();
+    last_cartgeom_  = at::Tensor();
+}
\ No newline at end of file
@@ -9,6 +9,14 @@
 
 namespace Hd {
 
+// Kernel is inference-only: the networks are frozen in eval mode,
+// and the input Cartesian coordinate is detached, so an evaluation builds no autograd graph
+// (except the transient one inside compute_Hd_dHd_ddHd)
+// After construction a Kernel holds no mutable state, so its const member functions
+// can be called on one Kernel from many threads at once without locks,
+// where each thread works on its own temporaries
+// A batch evaluation opens an OpenMP parallel region,
+// which runs serially if called from within another parallel region
 class Kernel {
     private:
         // generate CNPI group symmetry adapted and scaled internal coordinate from Cartesian coordinate
@@ -17,6 +25,11 @@ class Kernel {
         std::shared_ptr<obnet::symat> Hdnet1_, Hdnet2_;
         // generate Hd network input layer from SASDIC
         std::shared_ptr<InputGenerator> input_generator1_, input_generator2_;
+
+        // given Cartesian coordinate r, return Hd
+        at::Tensor compute_Hd_(const at::Tensor & r) const;
+        // given Cartesian coordinate r, return Hd and ▽Hd
+        std::tuple<at::Tensor, at::Tensor> compute_Hd_dHd_(const at::Tensor & r) const;
     public:
         Kernel();
         Kernel(const std::string & format1, const std::string & IC1, const std::string & SAS1,
@@ -30,12 +43,24 @@ class Kernel {
 
         size_t NStates() const;
 
+        // r can be a single Cartesian coordinate vector,
+        // or a batch of N Cartesian coordinate vectors (N x cartdim),
+        // whose internal coordinates and polynomials are evaluated in parallel while SASDIC and the networks batched,
+        // then Hd is N x NStates x NStates and ▽Hd is N x NStates x NStates x cartdim (empty if N = 0)
+
         // given Cartesian coordinate r, return Hd
         at::Tensor operator()(const at::Tensor & r) const;
 
         // given Cartesian coordinate r, return Hd and ▽Hd
         std::tuple<at::Tensor, at::Tensor> compute_Hd_dHd(const at::Tensor & r) const;
 
+        // given Cartesian coordinate vector r, return Hd, ▽Hd and ▽▽Hd
+        std::tuple<at::Tensor, at::Tensor, at::Tensor> compute_Hd_dHd_ddHd(const at::Tensor & r) const;
+        // given Cartesian coordinate vector r, return adiabatic energy, (▽H)a and ▽[(▽H)a]
+        // ▽[(▽H)a] accounts for the rotation of the adiabatic states (nonadiabatic coupling),
+        // so it diverges at degeneracy except for sums over the degenerate states
+        std::tuple<at::Tensor, at::Tensor, at::Tensor> compute_energy_dHa_ddHa(const at::Tensor & r) const;
+
         // output hidden layer values before activation to `os`
         void diagnostic(const at::Tensor & r, std::ostream & os);
 };
@@ -65,6 +65,10 @@ if(NOT CL_FOUND)
     list(APPEND Hd_LIBRARIES ${CL_LIBRARIES})
 endif()
 
+# dependency: OpenMP
+find_package(OpenMP REQUIRED)
+set(Hd_CXX_FLAGS "${Hd_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+
 # import location
 find_library(Hd_LIBRARY Hd PATHS "${HdROOT}/lib")
 set_target_properties(Hd PROPERTIES
@@ -1,9 +1,184 @@
+#include <tchem/linalg.hpp>
+
 #include <Hderiva/diabatic.hpp>
 
 #include <Hd/Kernel.hpp>
 
 namespace Hd {
 
+namespace {
+
+// run f(i) for i in [0, N) in parallel, then rethrow the 1st exception if any
+void parallel_for(const size_t & N, const std::function<void(const size_t &)> & f) {
+    std::vector<std::exception_ptr> errors(N);
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < N; i++) {
+        try {f(i);}
+        catch (...) {errors[i] = std::current_exception();}
+    }
+    for (const auto & error : errors) if (error) std::rethrow_exception(error);
+}
+
+// given a batch of Cartesian coordinates r (N x cartdim), return the batched input layers
+// tchem internal coordinates and polynomials take one geometry at a time, so they run in parallel over geometries,
+// while SASDIC is evaluated in one batched pass
+CL::utility::matrix<at::Tensor> batch_input(
+const std::shared_ptr<SASDIC::SASDICSet> & sasicset, const std::shared_ptr<InputGenerator> & input_generator,
+const at::Tensor & r) {
+    int64_t N = r.size(0);
+    std::vector<at::Tensor> qs(N);
+    parallel_for(N, [&](const size_t & n) {qs[n] = sasicset->tchem::IC::IntCoordSet::operator()(r[n]);});
+    std::vector<at::Tensor> sasdics = (*sasicset)(at::stack(qs));
+    std::vector<CL::utility::matrix<at::Tensor>> xss(N);
+    parallel_for(N, [&](const size_t & n) {
+        std::vector<at::Tensor> sasdics_n(sasdics.size());
+        for (size_t l = 0; l < sasdics.size(); l++) sasdics_n[l] = sasdics[l][n];
+        xss[n] = (*input_generator)(sasdics_n);
+    });
+    size_t NStates = input_generator->polynomials().size();
+    CL::utility::matrix<at::Tensor> xs(NStates);
+    std::vector<at::Tensor> xs_ij(N);
+    for (size_t i = 0; i < NStates; i++)
+    for (size_t j = i; j < NStates; j++) {
+        for (int64_t n = 0; n < N; n++) xs_ij[n] = xss[n][i][j];
+        xs[i][j] = at::stack(xs_ij);
+    }
+    return xs;
+}
+
+// given a batch of Cartesian coordinates r (N x cartdim), return the batched input layers,
+// their transposed Jacobians over SASDIC (N x NSASDICs x number of input features),
+// and the transposed Jacobians of SASDIC over r (N x cartdim x NSASDICs)
+std::tuple<CL::utility::matrix<at::Tensor>, CL::utility::matrix<at::Tensor>, at::Tensor> batch_input_J(
+const std::shared_ptr<SASDIC::SASDICSet> & sasicset, const std::shared_ptr<InputGenerator> & input_generator,
+const at::Tensor & r) {
+    int64_t N = r.size(0);
+    std::vector<at::Tensor> qs(N), Jqrs(N);
+    parallel_for(N, [&](const size_t & n) {std::tie(qs[n], Jqrs[n]) = sasicset->compute_IC_J(r[n]);});
+    std::vector<at::Tensor> sasdics, Jsqs;
+    std::tie(sasdics, Jsqs) = sasicset->compute_SASDIC_J(at::stack(qs));
+    at::Tensor JsrT = at::matmul(at::cat(Jsqs, 1), at::stack(Jqrs)).transpose(1, 2);
+    std::vector<CL::utility::matrix<at::Tensor>> xss(N), JTss(N);
+    parallel_for(N, [&](const size_t & n) {
+        std::vector<at::Tensor> sasdics_n(sasdics.size());
+        for (size_t l = 0; l < sasdics.size(); l++) sasdics_n[l] = sasdics[l][n];
+        std::tie(xss[n], JTss[n]) = input_generator->compute_x_JT(sasdics_n);
+    });
+    size_t NStates = input_generator->polynomials().size();
+    CL::utility::matrix<at::Tensor> xs(NStates), JTs(NStates);
+    std::vector<at::Tensor> xs_ij(N), JTs_ij(N);
+    for (size_t i = 0; i < NStates; i++)
+    for (size_t j = i; j < NStates; j++) {
+        for (int64_t n = 0; n < N; n++) {
+            xs_ij[n] = xss[n][i][j];
+            JTs_ij[n] = JTss[n][i][j];
+        }
+         xs[i][j] = at::stack(xs_ij);
+        JTs[i][j] = at::stack(JTs_ij);
+    }
+    return std::make_tuple(xs, JTs, JsrT);
+}
+
+// sum over k of g_k ▽▽x_k over SASDIC, where x is the input layer of element ij,
+// by autograd through the polynomials of this element only
+at::Tensor input_curvature(const std::shared_ptr<InputGenerator> & input_generator,
+const size_t & i, const size_t & j, const std::vector<at::Tensor> & qs, const at::Tensor & g) {
+    torch::AutoGradMode enable_grad(true);
+    std::vector<at::Tensor> qs_grad(qs.size());
+    int64_t NSASDICs = 0;
+    for (size_t l = 0; l < qs.size(); l++) {
+        qs_grad[l] = qs[l].detach().clone();
+        qs_grad[l].set_requires_grad(true);
+        NSASDICs += qs[l].size(0);
+    }
+    at::Tensor curvature = g.new_zeros({NSASDICs, NSASDICs});
+    at::Tensor phi = g.dot((*input_generator->polynomials()[i][j])(qs_grad));
+    if (! phi.requires_grad()) return curvature;
+    std::vector<at::Tensor> dphis = torch::autograd::grad({phi}, qs_grad, {}, true, true, true);
+    for (size_t l = 0; l < qs.size(); l++) if (! dphis[l].defined()) dphis[l] = qs[l].new_zeros(qs[l].sizes());
+    at::Tensor dphi = at::cat(dphis);
+    if (! dphi.requires_grad()) return curvature;
+    for (int64_t m = 0; m < NSASDICs; m++) {
+        std::vector<at::Tensor> hs = torch::autograd::grad({dphi[m]}, qs_grad, {}, true, false, true);
+        for (size_t l = 0; l < qs.size(); l++) if (! hs[l].defined()) hs[l] = qs[l].new_zeros(qs[l].sizes());
+        curvature[m] = at::cat(hs);
+    }
+    return curvature;
+}
+
+// add the contribution of a network to Hd, ▽Hd, ▽▽Hd at Cartesian coordinate r
+// Through Cartesian coordinate r -> internal coordinate q -> SASDIC s -> input layer x -> Hd
+//     ▽q▽q Hd = Jsq^T . (Jxs^T . ▽x▽x Hd . Jxs + sum over k of ▽x_k Hd * ▽s▽s x_k) . Jsq
+//             + sum over m of ▽s_m Hd * ▽q▽q s_m
+//     ▽r▽r Hd = Jqr^T . ▽q▽q Hd . Jqr + sum over n of ▽q_n Hd * ▽r▽r q_n
+// The maps are evaluated once for all elements, where the network and SASDIC terms are analytical,
+// the polynomial curvature is obtained by autograd through the polynomials (in parallel over elements),
+// the internal coordinate curvature by autograd through the internal coordinates (in parallel over r)
+void add_Hd_dHd_ddHd(
+const std::shared_ptr<SASDIC::SASDICSet> & sasicset, const std::shared_ptr<InputGenerator> & input_generator,
+const std::shared_ptr<obnet::symat> & Hdnet,
+const at::Tensor & r, at::Tensor & Hd, at::Tensor & dHd, at::Tensor & ddHd) {
+    size_t NStates = Hdnet->NStates();
+    int64_t cartdim = r.size(0);
+    // Cartesian coordinate -> CNPI group symmetry adaptated and scaled internal coordinate
+    at::Tensor q, Jqr;
+    std::tie(q, Jqr) = sasicset->compute_IC_J(r);
+    std::vector<at::Tensor> qs, Jsqs, Hsqs;
+    std::tie(qs, Jsqs, Hsqs) = sasicset->compute_SASDIC_J_Hess(q);
+    at::Tensor Jsq = at::cat(Jsqs), Hsq = at::cat(Hsqs);
+    // SASDIC -> input layer
+    CL::utility::matrix<at::Tensor> xs(NStates), JxsTs(NStates);
+    std::tie(xs, JxsTs) = input_generator->compute_x_JT(qs);
+    // input layer -> Hd, and its gradient and Hessian over input layer
+    at::Tensor y;
+    CL::utility::matrix<at::Tensor> dys(NStates), ddys(NStates);
+    std::tie(y, dys, ddys) = Hdnet->forward_Hessian(xs);
+    // the "upper triangle" elements line by line
+    std::vector<std::pair<size_t, size_t>> elements;
+    for (size_t i = 0; i < NStates; i++)
+    for (size_t j = i; j < NStates; j++)
+    elements.push_back({i, j});
+    // ▽q Hd and ▽q▽q Hd
+    at::Tensor  dqHd = q.new_empty({(int64_t)elements.size(), q.size(0)}),
+               ddqHd = q.new_empty({(int64_t)elements.size(), q.size(0), q.size(0)});
+    parallel_for(elements.size(), [&](const size_t & e) {
+        size_t i = elements[e].first, j = elements[e].second;
+        at::Tensor  dsHd = JxsTs[i][j].mv(dys[i][j]);
+        at::Tensor ddsHd = JxsTs[i][j].mm(ddys[i][j]).mm(JxsTs[i][j].transpose(0, 1))
+                         + input_curvature(input_generator, i, j, qs, dys[i][j]);
+         dqHd[e] = Jsq.transpose(0, 1).mv(dsHd);
+        ddqHd[e] = Jsq.transpose(0, 1).mm(ddsHd).mm(Jsq)
+                 + at::tensordot(dsHd, Hsq, {0}, {0});
+    });
+    // sum over n of ▽q_n Hd * ▽r▽r q_n, whose column k is ▽r(▽q Hd . ▽r_k q),
+    // where ▽r_k q = d / du (Jqr^T . u)[k] still depends on r
+    at::Tensor curvature = r.new_zeros({(int64_t)elements.size(), cartdim, cartdim});
+    parallel_for(cartdim, [&](const size_t & k) {
+        torch::AutoGradMode enable_grad(true);
+        at::Tensor r_grad = r.detach().clone();
+        r_grad.set_requires_grad(true);
+        at::Tensor q_grad = sasicset->tchem::IC::IntCoordSet::operator()(r_grad);
+        at::Tensor u = q.new_zeros(q.sizes());
+        u.set_requires_grad(true);
+        at::Tensor JqrTu = torch::autograd::grad({q_grad}, {r_grad}, {u}, true, true)[0];
+        at::Tensor Jqr_k = torch::autograd::grad({JqrTu[k]}, {u}, {}, true, true)[0];
+        if (! Jqr_k.requires_grad()) return;
+        for (size_t e = 0; e < elements.size(); e++) {
+            at::Tensor h = torch::autograd::grad({dqHd[e].dot(Jqr_k)}, {r_grad}, {}, true, false, true)[0];
+            if (h.defined()) curvature[e][k] = h;
+        }
+    });
+    // internal coordinate -> Cartesian coordinate
+    for (size_t e = 0; e < elements.size(); e++) {
+        size_t i = elements[e].first, j = elements[e].second;
+          Hd[i][j] += y[i][j];
+         dHd[i][j] += Jqr.transpose(0, 1).mv(dqHd[e]);
+        ddHd[i][j] += Jqr.transpose(0, 1).mm(ddqHd[e]).mm(Jqr) + curvature[e];
+    }
+}
+
+}
+
 Kernel::Kernel() {}
 Kernel::Kernel(
 const std::string & format1, const std::string & IC1, const std::string & SAS1,
@@ -55,9 +230,10 @@ Kernel::~Kernel() {}
 size_t Kernel::NStates() const {return Hdnet1_->NStates();}
 
 // given Cartesian coordinate r, return Hd
-at::Tensor Kernel::operator()(const at::Tensor & r) const {
-    if (r.sizes().size() != 1) throw std::invalid_argument(
-    "Hd::Kernel::operator(): r must be a vector");
+at::Tensor Kernel::compute_Hd_(const at::Tensor & _r) const {
+    // r is detached and the networks are frozen,
+    // so no autograd graph is built whatever the grad mode of the calling thread is
+    at::Tensor r = _r.detach();
     // Cartesian coordinate -> CNPI group symmetry adaptated and scaled internal coordinate
     at::Tensor q1 = sasicset1_->tchem::IC::IntCoordSet::operator()(r),
                q2 = sasicset2_->tchem::IC::IntCoordSet::operator()(r);
@@ -71,39 +247,17 @@ at::Tensor Kernel::operator()(const at::Tensor & r) const {
 }
 
 // given Cartesian coordinate r, return Hd and ▽Hd
-std::tuple<at::Tensor, at::Tensor> Kernel::compute_Hd_dHd(const at::Tensor & r) const {
-    if (r.sizes().size() != 1) throw std::invalid_argument(
-    "Hd::Kernel::compute_Hd_dHd: r must be a vector");
+std::tuple<at::Tensor, at::Tensor> Kernel::compute_Hd_dHd_(const at::Tensor & _r) const {
+    at::Tensor r = _r.detach();
     // Cartesian coordinate -> CNPI group symmetry adaptated and scaled internal coordinate
     at::Tensor q1, J1, q2, J2;
     std::tie(q1, J1) = sasicset1_->compute_IC_J(r);
     std::tie(q2, J2) = sasicset2_->compute_IC_J(r);
-    q1.set_requires_grad(true);
-    q2.set_requires_grad(true);
-    std::vector<at::Tensor> q1s = (*sasicset1_)(q1),
-                            q2s = (*sasicset2_)(q2);
-    std::vector<at::Tensor> Jq1rs = std::vector<at::Tensor>(q1s.size()),
-                            Jq2rs = std::vector<at::Tensor>(q2s.size());
-    for (size_t i = 0; i < q1s.size(); i++) {
-        Jq1rs[i] = q1s[i].new_empty({q1s[i].size(0), q1.size(0)});
-        for (size_t j = 0; j < q1s[i].size(0); j++) {
-            std::vector<at::Tensor> g = torch::autograd::grad({q1s[i][j]}, {q1}, {}, true);
-            Jq1rs[i][j].copy_(g[0]);
-        }
-        Jq1rs[i] = Jq1rs[i].mm(J1);
-    }
-    for (size_t i = 0; i < q2s.size(); i++) {
-        Jq2rs[i] = q2s[i].new_empty({q2s[i].size(0), q2.size(0)});
-        for (size_t j = 0; j < q2s[i].size(0); j++) {
-            std::vector<at::Tensor> g = torch::autograd::grad({q2s[i][j]}, {q2}, {}, true);
-            Jq2rs[i][j].copy_(g[0]);
-        }
-        Jq2rs[i] = Jq2rs[i].mm(J2);
-    }
-    at::Tensor Jq1rT = at::cat(Jq1rs).transpose(0, 1);
-    at::Tensor Jq2rT = at::cat(Jq2rs).transpose(0, 1);
-    for (at::Tensor & q : q1s) q.detach_();
-    for (at::Tensor & q : q2s) q.detach_();
+    std::vector<at::Tensor> q1s, Jq1qs, q2s, Jq2qs;
+    std::tie(q1s, Jq1qs) = sasicset1_->compute_SASDIC_J(q1);
+    std::tie(q2s, Jq2qs) = sasicset2_->compute_SASDIC_J(q2);
+    at::Tensor Jq1rT = at::cat(Jq1qs).mm(J1).transpose(0, 1);
+    at::Tensor Jq2rT = at::cat(Jq2qs).mm(J2).transpose(0, 1);
     // SASDIC -> input layer
     size_t NStates = Hdnet1_->NStates();
     CL::utility::matrix<at::Tensor> x1s(NStates), JxqT1s(NStates),
@@ -111,17 +265,9 @@ std::tuple<at::Tensor, at::Tensor> Kernel::compute_Hd_dHd(const at::Tensor & r)
     std::tie(x1s, JxqT1s) = input_generator1_->compute_x_JT(q1s);
     std::tie(x2s, JxqT2s) = input_generator2_->compute_x_JT(q2s);
     // input layer -> Hd and SASDIC ▽Hd
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++) {
-        x1s[i][j].set_requires_grad(true);
-        x2s[i][j].set_requires_grad(true);
-    }
-    at::Tensor Hd1 = (*Hdnet1_)(x1s),
-               Hd2 = (*Hdnet2_)(x2s);
-    at::Tensor DqHd1 = Hderiva::DxHd(Hd1, x1s, JxqT1s),
-               DqHd2 = Hderiva::DxHd(Hd2, x2s, JxqT2s);
-    Hd1.detach_();
-    Hd2.detach_();
+    at::Tensor Hd1, DqHd1, Hd2, DqHd2;
+    std::tie(Hd1, DqHd1) = Hdnet1_->forward_Jacobian(x1s, JxqT1s);
+    std::tie(Hd2, DqHd2) = Hdnet2_->forward_Jacobian(x2s, JxqT2s);
     // SASDIC ▽Hd -> Cartesian coordinate ▽Hd
     at::Tensor DrHd = Hd1.new_empty({Hd1.size(0), Hd1.size(1), r.size(0)});
     for (size_t i = 0; i < NStates; i++)
@@ -130,6 +276,89 @@ std::tuple<at::Tensor, at::Tensor> Kernel::compute_Hd_dHd(const at::Tensor & r)
     return std::make_tuple(Hd1 + Hd2, DrHd);
 }
 
+// r can be a single Cartesian coordinate vector,
+// or a batch of N Cartesian coordinate vectors (N x cartdim),
+// whose internal coordinates and polynomials are evaluated in parallel while SASDIC and the networks batched,
+// then Hd is N x NStates x NStates and ▽Hd is N x NStates x NStates x cartdim (empty if N = 0)
+
+// given Cartesian coordinate r, return Hd
+at::Tensor Kernel::operator()(const at::Tensor & _r) const {
+    if (_r.sizes().size() == 1) return compute_Hd_(_r);
+    if (_r.sizes().size() != 2) throw std::invalid_argument(
+    "Hd::Kernel::operator(): r must be a vector or a batch of vectors");
+    int64_t NStates = Hdnet1_->NStates();
+    if (_r.size(0) == 0) return _r.new_empty({0, NStates, NStates});
+    at::Tensor r = _r.detach();
+    // the networks evaluate the whole batch at once
+    return Hdnet1_->forward_batch(batch_input(sasicset1_, input_generator1_, r))
+         + Hdnet2_->forward_batch(batch_input(sasicset2_, input_generator2_, r));
+}
+
+// given Cartesian coordinate r, return Hd and ▽Hd
+std::tuple<at::Tensor, at::Tensor> Kernel::compute_Hd_dHd(const at::Tensor & _r) const {
+    if (_r.sizes().size() == 1) return compute_Hd_dHd_(_r);
+    if (_r.sizes().size() != 2) throw std::invalid_argument(
+    "Hd::Kernel::compute_Hd_dHd: r must be a vector or a batch of vectors");
+    int64_t NStates = Hdnet1_->NStates();
+    if (_r.size(0) == 0) return std::make_tuple(_r.new_empty({0, NStates, NStates}),
+                                                _r.new_empty({0, NStates, NStates, _r.size(1)}));
+    at::Tensor r = _r.detach();
+    CL::utility::matrix<at::Tensor> x1s, JxsT1s, x2s, JxsT2s;
+    at::Tensor Jsr1T, Jsr2T;
+    std::tie(x1s, JxsT1s, Jsr1T) = batch_input_J(sasicset1_, input_generator1_, r);
+    std::tie(x2s, JxsT2s, Jsr2T) = batch_input_J(sasicset2_, input_generator2_, r);
+    // input layer -> Hd and SASDIC ▽Hd, the networks evaluate the whole batch at once
+    at::Tensor Hd1, DsHd1, Hd2, DsHd2;
+    std::tie(Hd1, DsHd1) = Hdnet1_->forward_batch_Jacobian(x1s, JxsT1s);
+    std::tie(Hd2, DsHd2) = Hdnet2_->forward_batch_Jacobian(x2s, JxsT2s);
+    // SASDIC ▽Hd -> Cartesian coordinate ▽Hd
+    at::Tensor DrHd = at::einsum("nrs,nijs->nijr", {Jsr1T, DsHd1})
+                    + at::einsum("nrs,nijs->nijr", {Jsr2T, DsHd2});
+    return std::make_tuple(Hd1 + Hd2, DrHd);
+}
+
+// given Cartesian coordinate vector r, return Hd, ▽Hd and ▽▽Hd
+std::tuple<at::Tensor, at::Tensor, at::Tensor> Kernel::compute_Hd_dHd_ddHd(const at::Tensor & r) const {
+    if (r.sizes().size() != 1) throw std::invalid_argument(
+    "Hd::Kernel::compute_Hd_dHd_ddHd: r must be a vector");
+    int64_t NStates = Hdnet1_->NStates(), cartdim = r.size(0);
+    at::Tensor   Hd = r.new_zeros({NStates, NStates}),
+                dHd = r.new_zeros({NStates, NStates, cartdim}),
+               ddHd = r.new_zeros({NStates, NStates, cartdim, cartdim});
+    add_Hd_dHd_ddHd(sasicset1_, input_generator1_, Hdnet1_, r.detach(), Hd, dHd, ddHd);
+    add_Hd_dHd_ddHd(sasicset2_, input_generator2_, Hdnet2_, r.detach(), Hd, dHd, ddHd);
+    return std::make_tuple(Hd, dHd, ddHd);
+}
+
+// given Cartesian coordinate vector r, return adiabatic energy, (▽H)a and ▽[(▽H)a]
+// ▽[(▽H)a] accounts for the rotation of the adiabatic states (nonadiabatic coupling),
+// so it diverges at degeneracy except for sums over the degenerate states
+std::tuple<at::Tensor, at::Tensor, at::Tensor> Kernel::compute_energy_dHa_ddHa(const at::Tensor & r) const {
+    at::Tensor Hd, dHd, ddHd;
+    std::tie(Hd, dHd, ddHd) = compute_Hd_dHd_ddHd(r);
+    torch::NoGradGuard no_grad;
+    int64_t NStates = Hd.size(0), cartdim = r.size(0);
+    at::Tensor energy, states;
+    std::tie(energy, states) = Hd.symeig(true);
+    at::Tensor dHa = tchem::linalg::UT_sy_U(dHd, states);
+    at::Tensor ddHa = tchem::linalg::UT_sy_U(ddHd.reshape({NStates, NStates, cartdim * cartdim}), states)
+                      .reshape({NStates, NStates, cartdim, cartdim});
+    // ▽U = U A, where A[m][n] = (▽H)a[m][n] / (E[n] - E[m]) for m != n is antisymmetric
+    at::Tensor dHa_full = dHa.clone();
+    for (int64_t i = 0; i < NStates; i++)
+    for (int64_t j = i + 1; j < NStates; j++)
+    dHa_full[j][i].copy_(dHa[i][j]);
+    at::Tensor A = dHa_full.new_zeros(dHa_full.sizes());
+    for (int64_t m = 0; m < NStates; m++)
+    for (int64_t n = 0; n < NStates; n++)
+    if (m != n) A[m][n].copy_(dHa_full[m][n] / (energy[n] - energy[m]));
+    // ▽_b (▽_a H)a = U^T ▽_b ▽_a Hd U + A_b^T (▽_a H)a + (▽_a H)a A_b,
+    // stored as ddHa[i][j][b][a] like a finite difference of (▽H)a along b
+    ddHa += at::einsum("mib,mja->ijba", {A, dHa_full})
+          + at::einsum("ima,mjb->ijba", {dHa_full, A});
+    return std::make_tuple(energy, dHa, ddHa);
+}
+
 // output hidden layer values before activation to `os`
 void Kernel::diagnostic(const at::Tensor & r, std::ostream & os) {
     if (r.sizes().size() != 1) throw std::invalid_argument(
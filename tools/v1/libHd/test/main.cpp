@@ -0,0 +1,77 @@
+#include <CppLibrary/chemistry.hpp>
+
+#include <tchem/linalg.hpp>
+
+#include <Hd/Kernel.hpp>
+
+// adiabatic energy and (▽H)a from Hd and ▽Hd,
+// with the phase of each adiabatic state aligned to `reference` so that finite differences are meaningful
+std::tuple<at::Tensor, at::Tensor> compute_energy_dHa(const Hd::Kernel & kernel, const at::Tensor & r, const at::Tensor & reference) {
+    at::Tensor Hd, dHd;
+    std::tie(Hd, dHd) = kernel.compute_Hd_dHd(r);
+    at::Tensor energy, states;
+    std::tie(energy, states) = Hd.symeig(true);
+    for (int64_t n = 0; n < states.size(1); n++)
+    if (states.select(1, n).dot(reference.select(1, n)).item<double>() < 0.0) states.select(1, n).neg_();
+    at::Tensor dHa = tchem::linalg::UT_sy_U(dHd, states);
+    return std::make_tuple(energy, dHa);
+}
+
+int main() {
+    c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
+
+    // a randomly initialized network serves as the checkpoint
+    auto Hdnet = std::make_shared<obnet::symat>("Hd.in");
+    Hdnet->to(torch::kFloat64);
+    torch::save(Hdnet->elements, "Hd.pt");
+    std::vector<std::string> input_layers = {"11.in", "12.in", "22.in"};
+    Hd::Kernel kernel("default", "IntCoordDef", "SAS.in", "Hd.in", "Hd.pt", input_layers,
+                      "default", "IntCoordDef", "SAS.in", "Hd.in", "Hd.pt", input_layers);
+
+    CL::chem::xyz<double> geom("min-C1.xyz", true);
+    std::vector<double> coords = geom.coords();
+    at::Tensor r = at::from_blob(coords.data(), coords.size(), top).clone();
+    int64_t NStates = kernel.NStates(), cartdim = r.size(0);
+    const double dr = 1e-4;
+
+    at::Tensor Hd, dHd, ddHd;
+    std::tie(Hd, dHd, ddHd) = kernel.compute_Hd_dHd_ddHd(r);
+    at::Tensor energy, dHa, ddHa;
+    std::tie(energy, dHa, ddHa) = kernel.compute_energy_dHa_ddHa(r);
+    // the adiabatic states to align the phases of the displaced geometries to
+    at::Tensor eigenvalues, states;
+    std::tie(eigenvalues, states) = Hd.symeig(true);
+    std::cout << "The minimum energy gap, should be far from 0 (non-degenerate):\n"
+              << (energy.slice(0, 1) - energy.slice(0, 0, -1)).min().item<double>() << '\n';
+
+    // central finite differences of ▽Hd and (▽H)a, stored as [i][j][b][a] along b
+    at::Tensor ddHd_fd = ddHd.new_empty(ddHd.sizes()),
+               ddHa_fd = ddHa.new_empty(ddHa.sizes());
+    for (int64_t b = 0; b < cartdim; b++) {
+        at::Tensor r_plus = r.clone(), r_minus = r.clone();
+        r_plus [b] += dr;
+        r_minus[b] -= dr;
+        at::Tensor Hd_plus, dHd_plus, Hd_minus, dHd_minus;
+        std::tie(Hd_plus , dHd_plus ) = kernel.compute_Hd_dHd(r_plus );
+        std::tie(Hd_minus, dHd_minus) = kernel.compute_Hd_dHd(r_minus);
+        ddHd_fd.select(2, b).copy_((dHd_plus - dHd_minus) / (2.0 * dr));
+        at::Tensor e_plus, dHa_plus, e_minus, dHa_minus;
+        std::tie(e_plus , dHa_plus ) = compute_energy_dHa(kernel, r_plus , states);
+        std::tie(e_minus, dHa_minus) = compute_energy_dHa(kernel, r_minus, states);
+        ddHa_fd.select(2, b).copy_((dHa_plus - dHa_minus) / (2.0 * dr));
+    }
+
+    // only the upper triangle is meaningful
+    double difference_Hd = 0.0, difference_Ha = 0.0, norm_Hd = 0.0, norm_Ha = 0.0;
+    for (int64_t i = 0; i < NStates; i++)
+    for (int64_t j = i; j < NStates; j++) {
+        difference_Hd += (ddHd[i][j] - ddHd_fd[i][j]).norm().item<double>();
+        difference_Ha += (ddHa[i][j] - ddHa_fd[i][j]).norm().item<double>();
+        norm_Hd += ddHd[i][j].norm().item<double>();
+        norm_Ha += ddHa[i][j].norm().item<double>();
+    }
+    std::cout << "\n▽▽Hd against finite difference of ▽Hd, should print close to 0:\n"
+              << difference_Hd / norm_Hd << '\n';
+    std::cout << "\n▽[(▽H)a] against finite difference of (▽H)a, should print close to 0:\n"
+              << difference_Ha / norm_Ha << '\n';
+}
\ No newline at end of file
@@ -29,46 +29,17 @@ argparse::ArgumentParser parse_args(const size_t & argc, const char ** & argv) {
     return parser;
 }
 
-// computed by finite difference of (▽H)d
+// ▽▽Hd, analytical
 at::Tensor compute_ddHd(const at::Tensor & r, const Hd::Kernel & HdKernel) {
-    const double dr = 1e-3;
-    std::vector<at::Tensor> plus(r.size(0)), minus(r.size(0));
-    #pragma omp parallel for
-    for (size_t i = 0; i < r.size(0); i++) {
-        at::Tensor Hd, dHd;
-        plus[i] = r.clone();
-        plus[i][i] += dr;
-        std::tie(Hd, plus[i]) = HdKernel.compute_Hd_dHd(plus[i]);
-        minus[i] = r.clone();
-        minus[i][i] -= dr;
-        std::tie(Hd, minus[i]) = HdKernel.compute_Hd_dHd(minus[i]);
-    }
-    at::Tensor ddHd = r.new_empty({plus[0].size(0), plus[0].size(1), r.size(0), r.size(0)});
-    for (size_t i = 0; i < r.size(0); i++) ddHd.select(2, i).copy_((plus[i] - minus[i]) / 2.0 / dr);
+    at::Tensor Hd, dHd, ddHd;
+    std::tie(Hd, dHd, ddHd) = HdKernel.compute_Hd_dHd_ddHd(r);
     return ddHd;
 }
 
-// here ddHa is ▽[(▽H)a], computed by finite difference of (▽H)a
+// here ddHa is ▽[(▽H)a], analytical
 at::Tensor compute_ddHa(const at::Tensor & r, const Hd::Kernel & HdKernel) {
-    // Here ddHa is ▽[(▽H)a], computed by finite difference of (▽H)a
-    const double dr = 1e-3;
-    std::vector<at::Tensor> plus(r.size(0)), minus(r.size(0));
-    #pragma omp parallel for
-    for (size_t i = 0; i < r.size(0); i++) {
-        at::Tensor Hd, dHd, energy, states;
-        plus[i] = r.clone();
-        plus[i][i] += dr;
-        std::tie(Hd, dHd) = HdKernel.compute_Hd_dHd(plus[i]);
-        std::tie(energy, states) = Hd.symeig(true);
-        plus[i] = tchem::linalg::UT_sy_U(dHd, states);
-        minus[i] = r.clone();
-        minus[i][i] -= dr;
-        std::tie(Hd, dHd) = HdKernel.compute_Hd_dHd(minus[i]);
-        std::tie(energy, states) = Hd.symeig(true);
-        minus[i] = tchem::linalg::UT_sy_U(dHd, states);
-    }
-    at::Tensor ddHa = r.new_empty({plus[0].size(0), plus[0].size(1), r.size(0), r.size(0)});
-    for (size_t i = 0; i < r.size(0); i++) ddHa.select(2, i).copy_((plus[i] - minus[i]) / 2.0 / dr);
+    at::Tensor energy, dHa, ddHa;
+    std::tie(energy, dHa, ddHa) = HdKernel.compute_energy_dHa_ddHa(r);
     return ddHa;
 }
 
@@ -20,11 +20,9 @@ const std::string & opt_chk) {
     auto energy_loader = torch::data::make_data_loader(* energy_set,
         torch::data::DataLoaderOptions(batch_size).drop_last(true));
 
-    int64_t NPars = 0;
-    for (const auto & p : Hdnet->elements->parameters()) NPars += p.numel();
-    std::cout << "There are " << NPars << " parameters to train\n\n";
-    at::Tensor c = at::empty(NPars, c10::TensorOptions().dtype(torch::kFloat64));
-    p2c(0, c.data_ptr<double>());
+    std::cout << "There are " << parameters.numel() << " parameters to train\n\n";
+    // optimize the flat buffer aliased by all copies of Hd network in place
+    at::Tensor c = parameters;
     // display initial residue
     std::cout << "The initial residue = "
               << at::cat({reg_residue(regset->examples()),
@@ -46,20 +44,14 @@ const std::string & opt_chk) {
         for (const auto & batch : * reg_loader) {
             c.grad().copy_(reg_gradient(batch));
             optimizer.step();
-            #pragma omp parallel for
-            for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) c2p(c.data_ptr<double>(), thread);
         }
         for (const auto & batch : * deg_loader) {
             c.grad().copy_(deg_gradient(batch));
             optimizer.step();
-            #pragma omp parallel for
-            for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) c2p(c.data_ptr<double>(), thread);
         }
         for (const auto & batch : * energy_loader) {
             c.grad().copy_(energy_gradient(batch));
             optimizer.step();
-            #pragma omp parallel for
-            for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) c2p(c.data_ptr<double>(), thread);
         }
         std::cout << '\n';
         CL::utility::show_time(std::cout);
@@ -12,6 +12,25 @@ size_t OMP_NUM_THREADS;
 // thread 0 shares the original Hdnet
 std::vector<std::shared_ptr<obnet::symat>> Hdnets;
 
+// the parameters of every copy alias this flat buffer,
+// so updating the buffer updates all threads without copying
+at::Tensor parameters;
+
+namespace {
+
+// let the parameters of Hdnet alias consecutive segments of buffer
+void alias_parameters(const std::shared_ptr<obnet::symat> & Hdnet, const at::Tensor & buffer) {
+    torch::NoGradGuard no_grad;
+    int64_t start = 0;
+    for (const at::Tensor & p : Hdnet->elements->parameters()) {
+        int64_t stop = start + p.numel();
+        p.set_data(buffer.slice(0, start, stop).view(p.sizes()));
+        start = stop;
+    }
+}
+
+}
+
 void initialize() {
     NStates = Hdnet->NStates();
 
@@ -26,6 +45,11 @@ void initialize() {
         Hdnets[i] = std::make_shared<obnet::symat>(Hdnet);
         Hdnets[i]->train();
     }
+
+    std::vector<at::Tensor> ps;
+    for (const at::Tensor & p : Hdnet->elements->parameters()) ps.push_back(p.detach().view(-1));
+    parameters = at::cat(ps);
+    for (size_t i = 0; i < OMP_NUM_THREADS; i++) alias_parameters(Hdnets[i], parameters);
 }
 
 } // namespace train
\ No newline at end of file
@@ -18,23 +18,10 @@ extern size_t OMP_NUM_THREADS;
 // thread 0 shares the original Hdnet
 extern std::vector<std::shared_ptr<obnet::symat>> Hdnets;
 
-inline void p2c(const size_t & thread, double * c) {
-    size_t count = 0;
-    for (const at::Tensor & p : Hdnets[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(&(c[count]), p.data_ptr<double>(), numel * sizeof(double));
-        count += numel;
-    }
-}
-inline void c2p(const double * c, const size_t & thread) {
-    torch::NoGradGuard no_grad;
-    size_t count = 0;
-    for (const at::Tensor & p : Hdnets[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(p.data_ptr<double>(), &(c[count]), numel * sizeof(double));
-        count += numel;
-    }
-}
+// the parameters of every copy alias this flat buffer,
+// so updating the buffer updates all threads without copying
+// (autograd states, e.g. gradients, remain thread private)
+extern at::Tensor parameters;
 
 inline std::tuple<at::Tensor, at::Tensor> define_adiabatz(
 const at::Tensor & Hd, const at::Tensor & DrHd,
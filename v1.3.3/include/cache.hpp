@@ -0,0 +1,97 @@
+#ifndef cache_hpp
+#define cache_hpp
+
+#include <torch/torch.h>
+
+#include <CppLibrary/utility.hpp>
+
+// A versioned binary cache of the preprocessed data set
+// The file starts with a magic number, a format version and a key hashed from the inputs,
+// so a stale or foreign cache is simply rebuilt
+// Tensor buffers are aligned, so that reading back memory-maps the file and views it
+namespace cache {
+
+// bump whenever the layout of a cached class changes
+const uint64_t version = 1;
+
+// FNV-1a hash of `definition_strings` (e.g. option values), the contents of `definition_files`,
+// as well as the names, sizes and modification times of the files in `data_directories`
+uint64_t hash_inputs(const std::vector<std::string> & definition_strings,
+const std::vector<std::string> & definition_files, const std::vector<std::string> & data_directories);
+
+class Writer {
+    private:
+        std::ofstream ofs_;
+        size_t offset_ = 0;
+
+        void write_bytes_(const void * data, const size_t & size);
+        // pad the file so that the next tensor buffer starts at an aligned offset
+        void align_();
+    public:
+        Writer(const std::string & file, const uint64_t & key);
+        ~Writer();
+
+        // flush and close the file, return whether every write succeeded
+        bool close();
+
+        void write(const size_t & x);
+        void write(const double & x);
+        void write(const std::string & x);
+        void write(const at::Tensor & x);
+
+        template <typename T> void write(const std::vector<T> & xs) {
+            write(xs.size());
+            for (const T & x : xs) write(x);
+        }
+        // only the "upper triangle" (i <= j) is written
+        template <typename T> void write(const CL::utility::matrix<T> & xs) {
+            write(xs.size(0));
+            for (size_t i = 0; i < xs.size(0); i++)
+            for (size_t j = i; j < xs.size(1); j++)
+            write(xs[i][j]);
+        }
+};
+
+class Reader {
+    private:
+        // the mapped file, kept alive until the last tensor viewing it is freed
+        std::shared_ptr<char> mapping_;
+        size_t size_ = 0, offset_ = 0;
+
+        const char * read_bytes_(const size_t & size);
+        // skip the padding before a tensor buffer
+        void align_();
+    public:
+        Reader();
+        ~Reader();
+
+        // map `file` and check its header,
+        // return false if `file` does not exist or was built by another version or other inputs
+        bool open(const std::string & file, const uint64_t & key);
+
+        void read(size_t & x);
+        void read(double & x);
+        void read(std::string & x);
+        // the tensor views the mapped file, which is private so in-place modification is fine
+        void read(at::Tensor & x);
+
+        template <typename T> void read(std::vector<T> & xs) {
+            size_t size;
+            read(size);
+            xs.resize(size);
+            for (T & x : xs) read(x);
+        }
+        // only the "upper triangle" (i <= j) is read
+        template <typename T> void read(CL::utility::matrix<T> & xs) {
+            size_t size;
+            read(size);
+            xs = CL::utility::matrix<T>(size);
+            for (size_t i = 0; i < xs.size(0); i++)
+            for (size_t j = i; j < xs.size(1); j++)
+            read(xs[i][j]);
+        }
+};
+
+} // namespace cache
+
+#endif
\ No newline at end of file
@@ -5,10 +5,17 @@
 
 #include "data_classes.hpp"
 
+// If `cache_file` is given, the data set is loaded from it when its key matches
+// the hash of `definition_strings`, `definition_files` and the data files,
+// otherwise it is built then written to `cache_file`
 std::tuple<std::shared_ptr<abinitio::DataSet<RegHam>>, std::shared_ptr<abinitio::DataSet<DegHam>>>
-read_data(const std::vector<std::string> & user_list);
+read_data(const std::vector<std::string> & user_list,
+const std::string & cache_file = "", const std::vector<std::string> & definition_files = {},
+const std::vector<std::string> & definition_strings = {});
 
-std::shared_ptr<abinitio::DataSet<Energy>> read_energy(const std::vector<std::string> & user_list);
+std::shared_ptr<abinitio::DataSet<Energy>> read_energy(const std::vector<std::string> & user_list,
+const std::string & cache_file = "", const std::vector<std::string> & definition_files = {},
+const std::vector<std::string> & definition_strings = {});
 
 // given a regular data set
 // return a shift and a width for feature scaling
@@ -4,6 +4,8 @@
 #include <abinitio/SAenergy.hpp>
 #include <abinitio/SAHamiltonian.hpp>
 
+#include "cache.hpp"
+
 class Energy : public abinitio::SAEnergy {
     private:
         // input layers and their transposed Jacobians over Cartesian coordinate
@@ -25,6 +27,17 @@ class Energy : public abinitio::SAEnergy {
             const CL::utility::matrix<at::Tensor> & shift1, const CL::utility::matrix<at::Tensor> & width1,
             const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Tensor> & width2
         );
+
+        // the number of double-precision numbers in the tensors read by the trainer
+        size_t arena_size() const;
+        // copy the tensors read by the trainer into `arena` starting from `offset`,
+        // then let them be views of `arena`, `offset` is advanced accordingly
+        void move_to_arena_(const at::Tensor & arena, size_t & offset);
+
+        // write every member, including those inherited, to the binary cache
+        void dump(cache::Writer & writer) const;
+        // read every member, including those inherited, from the binary cache
+        void load(cache::Reader & reader);
 };
 
 class RegHam : public abinitio::RegSAHam {
@@ -50,6 +63,17 @@ class RegHam : public abinitio::RegSAHam {
             const CL::utility::matrix<at::Tensor> & shift1, const CL::utility::matrix<at::Tensor> & width1,
             const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Tensor> & width2
         );
+
+        // the number of double-precision numbers in the tensors read by the trainer
+        size_t arena_size() const;
+        // copy the tensors read by the trainer into `arena` starting from `offset`,
+        // then let them be views of `arena`, `offset` is advanced accordingly
+        void move_to_arena_(const at::Tensor & arena, size_t & offset);
+
+        // write every member, including those inherited, to the binary cache
+        void dump(cache::Writer & writer) const;
+        // read every member, including those inherited, from the binary cache
+        void load(cache::Reader & reader);
 };
 
 class DegHam : public abinitio::DegSAHam {
@@ -75,6 +99,17 @@ class DegHam : public abinitio::DegSAHam {
             const CL::utility::matrix<at::Tensor> & shift1, const CL::utility::matrix<at::Tensor> & width1,
             const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Tensor> & width2
         );
+
+        // the number of double-precision numbers in the tensors read by the trainer
+        size_t arena_size() const;
+        // copy the tensors read by the trainer into `arena` starting from `offset`,
+        // then let them be views of `arena`, `offset` is advanced accordingly
+        void move_to_arena_(const at::Tensor & arena, size_t & offset);
+
+        // write every member, including those inherited, to the binary cache
+        void dump(cache::Writer & writer) const;
+        // read every member, including those inherited, from the binary cache
+        void load(cache::Reader & reader);
 };
 
 #endif
\ No newline at end of file
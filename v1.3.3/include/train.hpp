@@ -12,9 +12,20 @@ namespace trust_region {
 void initialize(
 const std::shared_ptr<abinitio::DataSet<RegHam>> & regset,
 const std::shared_ptr<abinitio::DataSet<DegHam>> & degset,
-const std::shared_ptr<abinitio::DataSet<Energy>> & energy_set);
+const std::shared_ptr<abinitio::DataSet<Energy>> & energy_set,
+const bool & contiguous = false);
 
-void optimize(const size_t & max_iteration);
+// Train with the dense Jacobian of the data rows,
+// with regularization solve each Levenberg-Marquardt step by at most `max_CG_iteration` conjugate gradient iterations
+void optimize(const size_t & max_iteration, const size_t & max_CG_iteration = 50);
+
+// Train without ever forming the Jacobian,
+// solve each Levenberg-Marquardt step by at most `max_CG_iteration` conjugate gradient iterations
+void optimize_matrix_free(const size_t & max_iteration, const size_t & max_CG_iteration = 50);
+
+// Train with the normal equations accumulated point by point,
+// so the memory scales as NPars^2 rather than NEqs x NPars
+void optimize_normal_equations(const size_t & max_iteration);
 
 } // namespace trust_region
 
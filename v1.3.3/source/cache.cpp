@@ -0,0 +1,211 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <experimental/filesystem>
+
+#include "../include/cache.hpp"
+
+namespace cache {
+
+namespace {
+
+const char magic[8] = {'D', 'I', 'A', 'B', 'A', 'T', 'Z', 'C'};
+
+// tensor buffers start at cache-line boundaries
+const size_t alignment = 64;
+
+const uint64_t FNV_offset = 14695981039346656037ULL,
+               FNV_prime  = 1099511628211ULL;
+
+inline void FNV1a(uint64_t & hash, const void * data, const size_t & size) {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_prime;
+    }
+}
+
+inline void FNV1a_file(uint64_t & hash, const std::string & file) {
+    std::ifstream ifs; ifs.open(file, std::ios::binary);
+    if (! ifs.good()) throw CL::utility::file_error(file);
+    std::string content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    ifs.close();
+    FNV1a(hash, content.data(), content.size());
+}
+
+}
+
+// FNV-1a hash of `definition_strings`, the contents of `definition_files`,
+// the names, sizes and modification times of the files in `data_directories`,
+// as well as the contents of the per-irreducible definitions listed in their point_defs.txt
+uint64_t hash_inputs(const std::vector<std::string> & definition_strings,
+const std::vector<std::string> & definition_files, const std::vector<std::string> & data_directories) {
+    uint64_t hash = FNV_offset;
+    FNV1a(hash, &version, sizeof(version));
+    // the sizes delimit the strings
+    for (const std::string & str : definition_strings) {
+        size_t size = str.size();
+        FNV1a(hash, &size, sizeof(size));
+        FNV1a(hash, str.data(), size);
+    }
+    for (const std::string & file : definition_files) FNV1a_file(hash, file);
+    namespace fs = std::experimental::filesystem;
+    for (const std::string & directory : data_directories) {
+        FNV1a(hash, directory.data(), directory.size());
+        // sort the entries since the iteration order is unspecified
+        std::vector<std::string> files;
+        for (const auto & entry : fs::directory_iterator(directory))
+        if (fs::is_regular_file(entry.status())) files.push_back(entry.path().string());
+        std::sort(files.begin(), files.end());
+        for (const std::string & file : files) {
+            struct stat status;
+            if (stat(file.c_str(), &status) != 0) throw CL::utility::file_error(file);
+            int64_t size = status.st_size, mtime = status.st_mtime;
+            FNV1a(hash, file.data(), file.size());
+            FNV1a(hash, &size, sizeof(size));
+            FNV1a(hash, &mtime, sizeof(mtime));
+        }
+        // the per-irreducible definitions may live outside the directory
+        std::ifstream ifs; ifs.open(directory + "point_defs.txt");
+        if (ifs.good()) {
+            std::vector<std::string> point_defs;
+            std::string line;
+            while (std::getline(ifs, line)) {
+                std::vector<std::string> strs = CL::utility::split(line);
+                for (const std::string & str : strs) point_defs.push_back(directory + str);
+            }
+            ifs.close();
+            std::sort(point_defs.begin(), point_defs.end());
+            point_defs.erase(std::unique(point_defs.begin(), point_defs.end()), point_defs.end());
+            for (const std::string & file : point_defs) {
+                FNV1a(hash, file.data(), file.size());
+                FNV1a_file(hash, file);
+            }
+        }
+    }
+    return hash;
+}
+
+void Writer::write_bytes_(const void * data, const size_t & size) {
+    ofs_.write(reinterpret_cast<const char *>(data), size);
+    offset_ += size;
+}
+void Writer::align_() {
+    static const char zeros[alignment] = {};
+    size_t padding = (alignment - offset_ % alignment) % alignment;
+    write_bytes_(zeros, padding);
+}
+
+Writer::Writer(const std::string & file, const uint64_t & key) {
+    ofs_.open(file, std::ios::binary);
+    if (! ofs_.good()) throw CL::utility::file_error(file);
+    write_bytes_(magic, sizeof(magic));
+    write(version);
+    write(key);
+}
+Writer::~Writer() {if (ofs_.is_open()) ofs_.close();}
+
+// flush and close the file, return whether every write succeeded
+bool Writer::close() {
+    ofs_.flush();
+    bool good = ofs_.good();
+    ofs_.close();
+    return good && ! ofs_.fail();
+}
+
+void Writer::write(const size_t & x) {write_bytes_(&x, sizeof(x));}
+void Writer::write(const double & x) {write_bytes_(&x, sizeof(x));}
+void Writer::write(const std::string & x) {
+    write(x.size());
+    write_bytes_(x.data(), x.size());
+}
+// undefined tensor is marked by dimension = -1
+void Writer::write(const at::Tensor & x) {
+    if (! x.defined()) {
+        write(static_cast<size_t>(-1));
+        return;
+    }
+    write(static_cast<size_t>(x.dim()));
+    for (const int64_t & size : x.sizes()) write(static_cast<size_t>(size));
+    write(static_cast<size_t>(x.scalar_type()));
+    at::Tensor contiguous = x.detach().contiguous();
+    align_();
+    write_bytes_(contiguous.data_ptr(), contiguous.numel() * contiguous.element_size());
+}
+
+const char * Reader::read_bytes_(const size_t & size) {
+    if (offset_ + size > size_) throw std::runtime_error("cache::Reader::read_bytes_: truncated cache");
+    const char * data = mapping_.get() + offset_;
+    offset_ += size;
+    return data;
+}
+void Reader::align_() {
+    offset_ += (alignment - offset_ % alignment) % alignment;
+}
+
+Reader::Reader() {}
+Reader::~Reader() {}
+
+// map `file` and check its header,
+// return false if `file` does not exist or was built by another version or other inputs
+bool Reader::open(const std::string & file, const uint64_t & key) {
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)(sizeof(magic) + 2 * sizeof(uint64_t))) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = status.st_size;
+    // private mapping: in-place modifications of the tensors never reach the file
+    void * address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) return false;
+    mapping_ = std::shared_ptr<char>(reinterpret_cast<char *>(address),
+        [size](char * address) {munmap(address, size);});
+    size_ = size;
+    offset_ = 0;
+    if (std::memcmp(read_bytes_(sizeof(magic)), magic, sizeof(magic)) != 0) return false;
+    size_t file_version, file_key;
+    read(file_version);
+    read(file_key);
+    return file_version == version && file_key == key;
+}
+
+void Reader::read(size_t & x) {std::memcpy(&x, read_bytes_(sizeof(x)), sizeof(x));}
+void Reader::read(double & x) {std::memcpy(&x, read_bytes_(sizeof(x)), sizeof(x));}
+void Reader::read(std::string & x) {
+    size_t size;
+    read(size);
+    x.assign(read_bytes_(size), size);
+}
+// the tensor views the mapped file, which is private so in-place modification is fine
+void Reader::read(at::Tensor & x) {
+    size_t dim;
+    read(dim);
+    if (dim == static_cast<size_t>(-1)) {
+        x = at::Tensor();
+        return;
+    }
+    std::vector<int64_t> sizes(dim);
+    for (int64_t & size : sizes) {
+        size_t temp;
+        read(temp);
+        size = temp;
+    }
+    size_t type;
+    read(type);
+    c10::TensorOptions top = c10::TensorOptions().dtype(static_cast<c10::ScalarType>(type));
+    align_();
+    int64_t numel = 1;
+    for (const int64_t & size : sizes) numel *= size;
+    const char * data = read_bytes_(numel * c10::elementSize(static_cast<c10::ScalarType>(type)));
+    // hold the mapping until this tensor is freed
+    std::shared_ptr<char> mapping = mapping_;
+    x = at::from_blob(const_cast<char *>(data), sizes, [mapping](void *) {}, top);
+}
+
+} // namespace cache
\ No newline at end of file
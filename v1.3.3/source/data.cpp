@@ -3,10 +3,71 @@
 #include "../include/global.hpp"
 #include "../include/data.hpp"
 
+namespace {
+
+template <typename T> void dump_set(cache::Writer & writer, const std::shared_ptr<abinitio::DataSet<T>> & set) {
+    writer.write(set->size_int());
+    for (const auto & data : set->examples()) data->dump(writer);
+}
+
+template <typename T> std::shared_ptr<abinitio::DataSet<T>> load_set(cache::Reader & reader) {
+    size_t size;
+    reader.read(size);
+    std::vector<std::shared_ptr<T>> examples(size);
+    for (auto & data : examples) {
+        data = std::make_shared<T>();
+        data->load(reader);
+    }
+    return std::make_shared<abinitio::DataSet<T>>(examples);
+}
+
+// write through a temporary file, which is moved to `cache_file` only if every write succeeded,
+// so that an interrupted run or a full disk never leaves a broken cache
+void write_cache(const std::string & cache_file, const uint64_t & key, const std::function<void(cache::Writer &)> & dump) {
+    std::string temporary = cache_file + ".tmp";
+    bool written = false;
+    try {
+        cache::Writer writer(temporary, key);
+        dump(writer);
+        written = writer.close();
+    }
+    catch (const std::exception & e) {
+        std::cerr << "Warning: " << e.what() << '\n';
+    }
+    if (written && std::rename(temporary.c_str(), cache_file.c_str()) == 0) {
+        std::cout << "Cached the preprocessed data set in " << cache_file << "\n\n";
+    }
+    else {
+        std::remove(temporary.c_str());
+        std::cerr << "Warning: failed to write the cache " << cache_file << ", the data set is not cached\n\n";
+    }
+}
+
+}
+
 std::tuple<std::shared_ptr<abinitio::DataSet<RegHam>>, std::shared_ptr<abinitio::DataSet<DegHam>>>
-read_data(const std::vector<std::string> & user_list) {
+read_data(const std::vector<std::string> & user_list,
+const std::string & cache_file, const std::vector<std::string> & definition_files,
+const std::vector<std::string> & definition_strings) {
     abinitio::SAReader reader(user_list, cart2CNPI);
     reader.pretty_print(std::cout);
+    uint64_t key = 0;
+    if (! cache_file.empty()) {
+        key = cache::hash_inputs(definition_strings, definition_files, reader.data_directories());
+        cache::Reader cache_reader;
+        if (cache_reader.open(cache_file, key)) {
+            std::cout << "Loading the preprocessed data set from " << cache_file << "\n\n";
+            // a corrupted cache is rebuilt rather than aborting every later run
+            try {
+                auto regset = load_set<RegHam>(cache_reader);
+                auto degset = load_set<DegHam>(cache_reader);
+                return std::make_tuple(regset, degset);
+            }
+            catch (const std::exception & e) {
+                std::cerr << "Warning: " << e.what() << ", rebuilding " << cache_file << "\n\n";
+            }
+        }
+    }
     // read the data set in symmetry adapted internal coordinate in standard form
     std::shared_ptr<abinitio::DataSet<abinitio::RegSAHam>> stdregset;
     std::shared_ptr<abinitio::DataSet<abinitio::DegSAHam>> stddegset;
@@ -29,12 +90,33 @@ read_data(const std::vector<std::string> & user_list) {
     // return
     std::shared_ptr<abinitio::DataSet<RegHam>> regset = std::make_shared<abinitio::DataSet<RegHam>>(pregs);
     std::shared_ptr<abinitio::DataSet<DegHam>> degset = std::make_shared<abinitio::DataSet<DegHam>>(pdegs);
+    if (! cache_file.empty()) write_cache(cache_file, key, [&](cache::Writer & writer) {
+        dump_set(writer, regset);
+        dump_set(writer, degset);
+    });
     return std::make_tuple(regset, degset);
 }
 
-std::shared_ptr<abinitio::DataSet<Energy>> read_energy(const std::vector<std::string> & user_list) {
+std::shared_ptr<abinitio::DataSet<Energy>> read_energy(const std::vector<std::string> & user_list,
+const std::string & cache_file, const std::vector<std::string> & definition_files,
+const std::vector<std::string> & definition_strings) {
     abinitio::SAReader reader(user_list, cart2CNPI);
     reader.pretty_print(std::cout);
+    uint64_t key = 0;
+    if (! cache_file.empty()) {
+        key = cache::hash_inputs(definition_strings, definition_files, reader.data_directories());
+        cache::Reader cache_reader;
+        if (cache_reader.open(cache_file, key)) {
+            std::cout << "Loading the preprocessed data set from " << cache_file << "\n\n";
+            // a corrupted cache is rebuilt rather than aborting every later run
+            try {
+                return load_set<Energy>(cache_reader);
+            }
+            catch (const std::exception & e) {
+                std::cerr << "Warning: " << e.what() << ", rebuilding " << cache_file << "\n\n";
+            }
+        }
+    }
     // read the data set in symmetry adapted internal coordinate in standard form
     auto stdset = reader.read_SAEnergySet();
     // process data
@@ -45,8 +127,11 @@ std::shared_ptr<abinitio::DataSet<Energy>> read_energy(const std::vector<std::st
         // precompute the input layers
         penergies[i] = std::make_shared<Energy>(energy, int2input1, int2input2);
     }
-    // return
-    return std::make_shared<abinitio::DataSet<Energy>>(penergies);
+    std::shared_ptr<abinitio::DataSet<Energy>> energy_set = std::make_shared<abinitio::DataSet<Energy>>(penergies);
+    if (! cache_file.empty()) write_cache(cache_file, key, [&](cache::Writer & writer) {
+        dump_set(writer, energy_set);
+    });
+    return energy_set;
 }
 
 // given a regular data set
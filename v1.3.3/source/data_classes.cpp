@@ -1,5 +1,41 @@
 #include "../include/data_classes.hpp"
 
+namespace {
+
+inline size_t numel(const std::vector<at::Tensor> & xs) {
+    size_t count = 0;
+    for (const at::Tensor & x : xs) count += x.numel();
+    return count;
+}
+// only the "upper triangle" (i <= j) is counted
+inline size_t numel(const CL::utility::matrix<at::Tensor> & xs) {
+    size_t count = 0;
+    for (size_t i = 0; i < xs.size(0); i++)
+    for (size_t j = i; j < xs.size(1); j++)
+    count += xs[i][j].numel();
+    return count;
+}
+
+// copy `x` into `arena` starting from `offset`, then let `x` be that view of `arena`
+inline void relocate_(at::Tensor & x, const at::Tensor & arena, size_t & offset) {
+    size_t stop = offset + x.numel();
+    at::Tensor view = arena.slice(0, offset, stop).view(x.sizes());
+    view.copy_(x);
+    x = view;
+    offset = stop;
+}
+inline void relocate_(std::vector<at::Tensor> & xs, const at::Tensor & arena, size_t & offset) {
+    for (at::Tensor & x : xs) relocate_(x, arena, offset);
+}
+// only the "upper triangle" (i <= j) is relocated
+inline void relocate_(CL::utility::matrix<at::Tensor> & xs, const at::Tensor & arena, size_t & offset) {
+    for (size_t i = 0; i < xs.size(0); i++)
+    for (size_t j = i; j < xs.size(1); j++)
+    relocate_(xs[i][j], arena, offset);
+}
+
+}
+
 Energy::Energy() {}
 Energy::Energy(const std::shared_ptr<abinitio::SAEnergy> & ham,
 std::tuple<CL::utility::matrix<at::Tensor>, CL::utility::matrix<at::Tensor>> (*q2x1)(const std::vector<at::Tensor> &),
@@ -42,6 +78,89 @@ const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Te
     }
 }
 
+// the number of double-precision numbers in the tensors read by the trainer
+size_t Energy::arena_size() const {
+    return numel(x1s_) + numel(x2s_) + energy_.numel();
+}
+// copy the tensors read by the trainer into `arena` starting from `offset`,
+// then let them be views of `arena`, `offset` is advanced accordingly
+void Energy::move_to_arena_(const at::Tensor & arena, size_t & offset) {
+    relocate_(x1s_, arena, offset);
+    relocate_(x2s_, arena, offset);
+    relocate_(energy_, arena, offset);
+}
+
+// write every member, including those inherited, to the binary cache
+void Energy::dump(cache::Writer & writer) const {
+    // abinitio::SAGeometry
+    writer.write(path_);
+    writer.write(sqrtweight_);
+    writer.write(weight_);
+    writer.write(geom_);
+    writer.write(CNPI_intdims_);
+    writer.write(qs_);
+    writer.write(Jqrs_);
+    writer.write(JqrTs_);
+    writer.write(Jqr_);
+    writer.write(JqrT_);
+    writer.write(Sq_);
+    writer.write(point_intdims_);
+    writer.write(Qs_);
+    writer.write(JQrs_);
+    writer.write(JQrTs_);
+    writer.write(C2Qs_);
+    writer.write(SQs_);
+    writer.write(sqrtSQs_);
+    writer.write(JQr_);
+    writer.write(JQrT_);
+    writer.write(CNPI2point_);
+    writer.write(point2CNPI_);
+    // abinitio::SAEnergy
+    writer.write(energy_);
+    writer.write(weight_E_);
+    writer.write(sqrtweight_E_);
+    // input layers
+    writer.write(x1s_);
+    writer.write(Jx1rTs_);
+    writer.write(x2s_);
+    writer.write(Jx2rTs_);
+}
+// read every member, including those inherited, from the binary cache
+void Energy::load(cache::Reader & reader) {
+    // abinitio::SAGeometry
+    reader.read(path_);
+    reader.read(sqrtweight_);
+    reader.read(weight_);
+    reader.read(geom_);
+    reader.read(CNPI_intdims_);
+    reader.read(qs_);
+    reader.read(Jqrs_);
+    reader.read(JqrTs_);
+    reader.read(Jqr_);
+    reader.read(JqrT_);
+    reader.read(Sq_);
+    reader.read(point_intdims_);
+    reader.read(Qs_);
+    reader.read(JQrs_);
+    reader.read(JQrTs_);
+    reader.read(C2Qs_);
+    reader.read(SQs_);
+    reader.read(sqrtSQs_);
+    reader.read(JQr_);
+    reader.read(JQrT_);
+    reader.read(CNPI2point_);
+    reader.read(point2CNPI_);
+    // abinitio::SAEnergy
+    reader.read(energy_);
+    reader.read(weight_E_);
+    reader.read(sqrtweight_E_);
+    // input layers
+    reader.read(x1s_);
+    reader.read(Jx1rTs_);
+    reader.read(x2s_);
+    reader.read(Jx2rTs_);
+}
+
 
 
 
@@ -88,6 +207,212 @@ const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Te
     }
 }
 
+// the number of double-precision numbers in the tensors read by the trainer
+size_t RegHam::arena_size() const {
+    return numel(x1s_) + numel(Jx1rTs_) + numel(x2s_) + numel(Jx2rTs_)
+         + energy_.numel() + dH_.numel()
+         + numel(C2Qs_) + numel(sqrtSQs_) + numel(SAdH_);
+}
+// copy the tensors read by the trainer into `arena` starting from `offset`,
+// then let them be views of `arena`, `offset` is advanced accordingly
+void RegHam::move_to_arena_(const at::Tensor & arena, size_t & offset) {
+    relocate_(x1s_   , arena, offset);
+    relocate_(Jx1rTs_, arena, offset);
+    relocate_(x2s_   , arena, offset);
+    relocate_(Jx2rTs_, arena, offset);
+    relocate_(energy_, arena, offset);
+    relocate_(dH_    , arena, offset);
+    relocate_(C2Qs_   , arena, offset);
+    relocate_(sqrtSQs_, arena, offset);
+    relocate_(SAdH_   , arena, offset);
+}
+
+// write every member, including those inherited, to the binary cache
+void DegHam::dump(cache::Writer & writer) const {
+    // abinitio::SAGeometry
+    writer.write(path_);
+    writer.write(sqrtweight_);
+    writer.write(weight_);
+    writer.write(geom_);
+    writer.write(CNPI_intdims_);
+    writer.write(qs_);
+    writer.write(Jqrs_);
+    writer.write(JqrTs_);
+    writer.write(Jqr_);
+    writer.write(JqrT_);
+    writer.write(Sq_);
+    writer.write(point_intdims_);
+    writer.write(Qs_);
+    writer.write(JQrs_);
+    writer.write(JQrTs_);
+    writer.write(C2Qs_);
+    writer.write(SQs_);
+    writer.write(sqrtSQs_);
+    writer.write(JQr_);
+    writer.write(JQrT_);
+    writer.write(CNPI2point_);
+    writer.write(point2CNPI_);
+    // abinitio::SAEnergy
+    writer.write(energy_);
+    writer.write(weight_E_);
+    writer.write(sqrtweight_E_);
+    // abinitio::RegSAHam
+    writer.write(dH_);
+    writer.write(irreds_);
+    writer.write(SAdH_);
+    writer.write(weight_dH_);
+    writer.write(sqrtweight_dH_);
+    // abinitio::DegSAHam
+    writer.write(H_);
+    writer.write(weight_H_);
+    writer.write(sqrtweight_H_);
+    // input layers
+    writer.write(x1s_);
+    writer.write(Jx1rTs_);
+    writer.write(x2s_);
+    writer.write(Jx2rTs_);
+    // pretrained part
+    writer.write(pretrained_Hd_);
+    writer.write(pretrained_DrHd_);
+}
+// read every member, including those inherited, from the binary cache
+void DegHam::load(cache::Reader & reader) {
+    // abinitio::SAGeometry
+    reader.read(path_);
+    reader.read(sqrtweight_);
+    reader.read(weight_);
+    reader.read(geom_);
+    reader.read(CNPI_intdims_);
+    reader.read(qs_);
+    reader.read(Jqrs_);
+    reader.read(JqrTs_);
+    reader.read(Jqr_);
+    reader.read(JqrT_);
+    reader.read(Sq_);
+    reader.read(point_intdims_);
+    reader.read(Qs_);
+    reader.read(JQrs_);
+    reader.read(JQrTs_);
+    reader.read(C2Qs_);
+    reader.read(SQs_);
+    reader.read(sqrtSQs_);
+    reader.read(JQr_);
+    reader.read(JQrT_);
+    reader.read(CNPI2point_);
+    reader.read(point2CNPI_);
+    // abinitio::SAEnergy
+    reader.read(energy_);
+    reader.read(weight_E_);
+    reader.read(sqrtweight_E_);
+    // abinitio::RegSAHam
+    reader.read(dH_);
+    reader.read(irreds_);
+    reader.read(SAdH_);
+    reader.read(weight_dH_);
+    reader.read(sqrtweight_dH_);
+    // abinitio::DegSAHam
+    reader.read(H_);
+    reader.read(weight_H_);
+    reader.read(sqrtweight_H_);
+    // input layers
+    reader.read(x1s_);
+    reader.read(Jx1rTs_);
+    reader.read(x2s_);
+    reader.read(Jx2rTs_);
+    // pretrained part
+    reader.read(pretrained_Hd_);
+    reader.read(pretrained_DrHd_);
+}
+
+// write every member, including those inherited, to the binary cache
+void RegHam::dump(cache::Writer & writer) const {
+    // abinitio::SAGeometry
+    writer.write(path_);
+    writer.write(sqrtweight_);
+    writer.write(weight_);
+    writer.write(geom_);
+    writer.write(CNPI_intdims_);
+    writer.write(qs_);
+    writer.write(Jqrs_);
+    writer.write(JqrTs_);
+    writer.write(Jqr_);
+    writer.write(JqrT_);
+    writer.write(Sq_);
+    writer.write(point_intdims_);
+    writer.write(Qs_);
+    writer.write(JQrs_);
+    writer.write(JQrTs_);
+    writer.write(C2Qs_);
+    writer.write(SQs_);
+    writer.write(sqrtSQs_);
+    writer.write(JQr_);
+    writer.write(JQrT_);
+    writer.write(CNPI2point_);
+    writer.write(point2CNPI_);
+    // abinitio::SAEnergy
+    writer.write(energy_);
+    writer.write(weight_E_);
+    writer.write(sqrtweight_E_);
+    // abinitio::RegSAHam
+    writer.write(dH_);
+    writer.write(irreds_);
+    writer.write(SAdH_);
+    writer.write(weight_dH_);
+    writer.write(sqrtweight_dH_);
+    // input layers
+    writer.write(x1s_);
+    writer.write(Jx1rTs_);
+    writer.write(x2s_);
+    writer.write(Jx2rTs_);
+    // pretrained part
+    writer.write(pretrained_Hd_);
+    writer.write(pretrained_DrHd_);
+}
+// read every member, including those inherited, from the binary cache
+void RegHam::load(cache::Reader & reader) {
+    // abinitio::SAGeometry
+    reader.read(path_);
+    reader.read(sqrtweight_);
+    reader.read(weight_);
+    reader.read(geom_);
+    reader.read(CNPI_intdims_);
+    reader.read(qs_);
+    reader.read(Jqrs_);
+    reader.read(JqrTs_);
+    reader.read(Jqr_);
+    reader.read(JqrT_);
+    reader.read(Sq_);
+    reader.read(point_intdims_);
+    reader.read(Qs_);
+    reader.read(JQrs_);
+    reader.read(JQrTs_);
+    reader.read(C2Qs_);
+    reader.read(SQs_);
+    reader.read(sqrtSQs_);
+    reader.read(JQr_);
+    reader.read(JQrT_);
+    reader.read(CNPI2point_);
+    reader.read(point2CNPI_);
+    // abinitio::SAEnergy
+    reader.read(energy_);
+    reader.read(weight_E_);
+    reader.read(sqrtweight_E_);
+    // abinitio::RegSAHam
+    reader.read(dH_);
+    reader.read(irreds_);
+    reader.read(SAdH_);
+    reader.read(weight_dH_);
+    reader.read(sqrtweight_dH_);
+    // input layers
+    reader.read(x1s_);
+    reader.read(Jx1rTs_);
+    reader.read(x2s_);
+    reader.read(Jx2rTs_);
+    // pretrained part
+    reader.read(pretrained_Hd_);
+    reader.read(pretrained_DrHd_);
+}
+
 
 
 
@@ -133,3 +458,24 @@ const CL::utility::matrix<at::Tensor> & shift2, const CL::utility::matrix<at::Te
         Jx2rTs_[i][j] /= width2[i][j];
     }
 }
+
+// the number of double-precision numbers in the tensors read by the trainer
+size_t DegHam::arena_size() const {
+    return numel(x1s_) + numel(Jx1rTs_) + numel(x2s_) + numel(Jx2rTs_)
+         + energy_.numel() + dH_.numel() + H_.numel()
+         + numel(C2Qs_) + numel(sqrtSQs_) + numel(SAdH_);
+}
+// copy the tensors read by the trainer into `arena` starting from `offset`,
+// then let them be views of `arena`, `offset` is advanced accordingly
+void DegHam::move_to_arena_(const at::Tensor & arena, size_t & offset) {
+    relocate_(x1s_   , arena, offset);
+    relocate_(Jx1rTs_, arena, offset);
+    relocate_(x2s_   , arena, offset);
+    relocate_(Jx2rTs_, arena, offset);
+    relocate_(energy_, arena, offset);
+    relocate_(dH_    , arena, offset);
+    relocate_(H_     , arena, offset);
+    relocate_(C2Qs_   , arena, offset);
+    relocate_(sqrtSQs_, arena, offset);
+    relocate_(SAdH_   , arena, offset);
+}
\ No newline at end of file
@@ -9,20 +9,11 @@ std::tuple<std::vector<at::Tensor>, std::vector<at::Tensor>> cart2CNPI(const at:
     // Cartesian coordinate -> internal coordinate
     at::Tensor q, J;
     std::tie(q, J) = sasicset->compute_IC_J(r);
-    q.set_requires_grad(true);
     // internal coordinate -> CNPI group symmetry adapted internal coordinate
-    std::vector<at::Tensor> qs = (*sasicset)(q);
-    std::vector<at::Tensor> Js = std::vector<at::Tensor>(qs.size());
-    for (size_t i = 0; i < qs.size(); i++) {
-        Js[i] = qs[i].new_empty({qs[i].size(0), q.size(0)});
-        for (size_t j = 0; j < qs[i].size(0); j++) {
-            std::vector<at::Tensor> g = torch::autograd::grad({qs[i][j]}, {q}, {}, true);
-            Js[i][j].copy_(g[0]);
-        }
-        Js[i] = Js[i].mm(J);
-    }
-    // free autograd graph
-    for (at::Tensor & q : qs) q.detach_();
+    std::vector<at::Tensor> qs, Jqs;
+    std::tie(qs, Jqs) = sasicset->compute_SASDIC_J(q);
+    std::vector<at::Tensor> Js(qs.size());
+    for (size_t i = 0; i < qs.size(); i++) Js[i] = Jqs[i].mm(J);
     return std::make_tuple(qs, Js);
 }
 
@@ -28,6 +28,7 @@ argparse::ArgumentParser parse_args(const size_t & argc, const char ** & argv) {
     parser.add_argument("-z","--zero_point",    1, true, "zero of potential energy, default = 0");
     parser.add_argument("--energy_weight"  ,  '+', true, "energy (reference, threshold) for each state in weight adjustment, default = (0, 1)");
     parser.add_argument("--gradient_weight",    1, true, "gradient threshold in weight adjustment, default = infer from energy threshold");
+    parser.add_argument("--cache",              1, true, "prefix of the binary cache of the preprocessed data set, rebuilt whenever the inputs change");
     // network 1
     parser.add_argument("--checkpoint1",     1, true, "a trained Hd parameter to continue from");
     parser.add_argument("--regularization1", 1, true, "regularization strength, can be a scalar or files regularization_state1-state2_layer.txt");
@@ -39,6 +40,10 @@ argparse::ArgumentParser parse_args(const size_t & argc, const char ** & argv) {
 
     // optimizer arguments
     parser.add_argument("-m","--max_iteration", 1, true, "default = 20");
+    parser.add_argument("--contiguous", (char)0, true, "pack each thread's data into a contiguous NUMA-local arena");
+    parser.add_argument("--matrix_free", (char)0, true, "never store the Jacobian, solve Levenberg-Marquardt steps by conjugate gradient");
+    parser.add_argument("--normal_equations", (char)0, true, "never store the Jacobian, accumulate and solve the normal equations");
+    parser.add_argument("--max_CG_iteration", 1, true, "conjugate gradient iterations per regularized or matrix-free step, default = 50");
 
     parser.parse_args(argc, argv);
     return parser;
@@ -50,6 +55,8 @@ int main(size_t argc, const char ** argv) {
     argparse::ArgumentParser args = parse_args(argc, argv);
     CL::utility::show_time(std::cout);
     std::cout << '\n';
+    if (args.gotArgument("matrix_free") && args.gotArgument("normal_equations")) throw std::invalid_argument(
+    "--matrix_free and --normal_equations are mutually exclusive");
 
     std::string format = args.retrieve<std::string>("format"),
                 IC     = args.retrieve<std::string>("IC"),
@@ -82,17 +89,27 @@ int main(size_t argc, const char ** argv) {
     "The number of input layers must match the number of Hd upper-triangle elements");
     input_generator2 = std::make_shared<InputGenerator>(Hdnet2->NStates(), Hdnet2->irreds(), input_layers2, sasicset->NSASDICs());
 
+    // the preprocessed data set depends on the SASDIC and input layer definitions
+    std::string cache_prefix;
+    if (args.gotArgument("cache")) cache_prefix = args.retrieve<std::string>("cache");
+    std::vector<std::string> definition_strings = {sasicset->format()},
+                             definition_files = sasicset->definition_files();
+    definition_files.insert(definition_files.end(), input_layers1.begin(), input_layers1.end());
+    definition_files.insert(definition_files.end(), input_layers2.begin(), input_layers2.end());
+
     std::vector<std::string> data = args.retrieve<std::vector<std::string>>("data");
     std::shared_ptr<abinitio::DataSet<RegHam>> regset;
     std::shared_ptr<abinitio::DataSet<DegHam>> degset;
-    std::tie(regset, degset) = read_data(data);
+    std::tie(regset, degset) = read_data(data,
+        cache_prefix.empty() ? "" : cache_prefix + "-data.cache", definition_files, definition_strings);
     std::cout << "There are " << regset->size_int() << " data points in adiabatic representation\n"
               << "          " << degset->size_int() << " data points in composite representation\n\n";
 
     std::vector<std::shared_ptr<Energy>> energy_examples;
     auto energy_set = std::make_shared<abinitio::DataSet<Energy>>(energy_examples);
     if (args.gotArgument("energy_data")) {
-        energy_set = read_energy(args.retrieve<std::vector<std::string>>("energy_data"));
+        energy_set = read_energy(args.retrieve<std::vector<std::string>>("energy_data"),
+            cache_prefix.empty() ? "" : cache_prefix + "-energy_data.cache", definition_files, definition_strings);
         std::cout << "There are " << energy_set->size_int() << " data points without gradient\n\n";
     }
 
@@ -206,8 +223,12 @@ int main(size_t argc, const char ** argv) {
     train::initialize();
     size_t max_iteration = 20;
     if (args.gotArgument("max_iteration")) max_iteration = args.retrieve<size_t>("max_iteration");
-    train::trust_region::initialize(regset, degset, energy_set);
-    train::trust_region::optimize(max_iteration);
+    train::trust_region::initialize(regset, degset, energy_set, args.gotArgument("contiguous"));
+    size_t max_CG_iteration = 50;
+    if (args.gotArgument("max_CG_iteration")) max_CG_iteration = args.retrieve<size_t>("max_CG_iteration");
+    if (args.gotArgument("matrix_free")) train::trust_region::optimize_matrix_free(max_iteration, max_CG_iteration);
+    else if (args.gotArgument("normal_equations")) train::trust_region::optimize_normal_equations(max_iteration);
+    else train::trust_region::optimize(max_iteration, max_CG_iteration);
 
     unscale_Hdnet(Hdnet1, shift1, width1);
     unscale_Hdnet(Hdnet2, shift2, width2);
@@ -1,6 +1,8 @@
+#include <functional>
+
 #include <tchem/linalg.hpp>
 
-#include <Hderiva/diabatic.hpp>
+#include <Hderiva/basic.hpp>
 #include <Hderiva/adiabatic.hpp>
 #include <Hderiva/composite.hpp>
 
@@ -8,43 +10,22 @@
 
 namespace train { namespace trust_region {
 
-inline void reg_Jacobian(const size_t & thread, const std::shared_ptr<RegHam> & data,
+// The Jacobian rows of a data point given Hd, ▽Hd and the blocks of d / dc Hd, d / dc ▽Hd (see `Hderiva::UT_blocks_U`)
+// The rows are linear in the blocks, so the width-1 blocks d / dc Hd . v, d / dc ▽Hd . v give Jv instead
+inline void reg_block_rows(const std::shared_ptr<RegHam> & data, const size_t & key, Memo & memo,
+const at::Tensor & Hd, const at::Tensor & DrHd,
+const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
 at::Tensor & J, size_t & start) {
-    // get necessary diabatic quantities
-    CL::utility::matrix<at::Tensor> x1s = data->x1s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x1s[i][j].set_requires_grad(true);
-    at::Tensor     Hd1 = Hdnet1s[thread]->forward(x1s);
-    at::Tensor   DrHd1 = Hderiva::DxHd(Hd1, x1s, data->Jx1rTs(), true);
-    at::Tensor   DcHd1 = Hderiva::DcHd(Hd1, Hdnet1s[thread]->elements->parameters());
-    at::Tensor DcDrHd1 = Hderiva::DcDxHd(DrHd1, Hdnet1s[thread]->elements->parameters());
-    CL::utility::matrix<at::Tensor> x2s = data->x2s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x2s[i][j].set_requires_grad(true);
-    at::Tensor     Hd2 = Hdnet2s[thread]->forward(x2s);
-    at::Tensor   DrHd2 = Hderiva::DxHd(Hd2, x2s, data->Jx2rTs(), true);
-    at::Tensor   DcHd2 = Hderiva::DcHd(Hd2, Hdnet2s[thread]->elements->parameters());
-    at::Tensor DcDrHd2 = Hderiva::DcDxHd(DrHd2, Hdnet2s[thread]->elements->parameters());
-    // stop autograd tracking
-      Hd1.detach_();
-    DrHd1.detach_();
-      Hd2.detach_();
-    DrHd2.detach_();
-    // combine both Hd networks
-    at::Tensor     Hd =   Hd1 +   Hd2;
-    at::Tensor   DrHd = DrHd1 + DrHd2;
-    at::Tensor   DcHd = at::cat({  DcHd1,   DcHd2}, -1);
-    at::Tensor DcDrHd = at::cat({DcDrHd1, DcDrHd2}, -1);
     // get adiabatic representation
     at::Tensor energy, states;
-    std::tie(energy, states) = define_adiabatz(Hd, DrHd, data->NStates(), data->dH());
+    std::tie(energy, states) = memoize(memo, key, [&]() {
+        return define_adiabatz(Hd, DrHd, data->dH(), memo.ordering);
+    });
     // compute fitting parameter gradient in adiabatic prediction
     int64_t NStates_data = data->NStates();
-    at::Tensor DcHa = tchem::linalg::UT_sy_U(DcHd, states);
     at::Tensor DrHa = tchem::linalg::UT_sy_U(DrHd, states);
-    at::Tensor DcDrHa = Hderiva::DcDxHa(DrHa, DcHd, DcDrHd, energy, states);
+    at::Tensor DcHa, DcDrHa;
+    std::tie(DcHa, DcDrHa) = Hderiva::block_DcHa_DcDxHa(DrHa, DcHd, DcDrHd, energy, states);
     CL::utility::matrix<at::Tensor> DcSADQHa(NStates_data);
     for (size_t i = 0; i < NStates_data; i++)
     for (size_t j = i; j < NStates_data; j++)
@@ -65,43 +46,20 @@ at::Tensor & J, size_t & start) {
     }
 }
 
-inline void deg_Jacobian(const size_t & thread, const std::shared_ptr<DegHam> & data,
+inline void deg_block_rows(const std::shared_ptr<DegHam> & data, const size_t & key, Memo & memo,
+const at::Tensor & Hd, const at::Tensor & DrHd,
+const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
 at::Tensor & J, size_t & start) {
-    // get necessary diabatic quantities
-    CL::utility::matrix<at::Tensor> x1s = data->x1s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x1s[i][j].set_requires_grad(true);
-    at::Tensor     Hd1 = Hdnet1s[thread]->forward(x1s);
-    at::Tensor   DrHd1 = Hderiva::DxHd(Hd1, x1s, data->Jx1rTs(), true);
-    at::Tensor   DcHd1 = Hderiva::DcHd(Hd1, Hdnet1s[thread]->elements->parameters());
-    at::Tensor DcDrHd1 = Hderiva::DcDxHd(DrHd1, Hdnet1s[thread]->elements->parameters());
-    CL::utility::matrix<at::Tensor> x2s = data->x2s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x2s[i][j].set_requires_grad(true);
-    at::Tensor     Hd2 = Hdnet2s[thread]->forward(x2s);
-    at::Tensor   DrHd2 = Hderiva::DxHd(Hd2, x2s, data->Jx2rTs(), true);
-    at::Tensor   DcHd2 = Hderiva::DcHd(Hd2, Hdnet2s[thread]->elements->parameters());
-    at::Tensor DcDrHd2 = Hderiva::DcDxHd(DrHd2, Hdnet2s[thread]->elements->parameters());
-    // stop autograd tracking
-      Hd1.detach_();
-    DrHd1.detach_();
-      Hd2.detach_();
-    DrHd2.detach_();
-    // combine both Hd networks
-    at::Tensor     Hd =   Hd1 +   Hd2;
-    at::Tensor   DrHd = DrHd1 + DrHd2;
-    at::Tensor   DcHd = at::cat({  DcHd1,   DcHd2}, -1);
-    at::Tensor DcDrHd = at::cat({DcDrHd1, DcDrHd2}, -1);
     // get composite representation
     at::Tensor eigval, eigvec;
-    std::tie(eigval, eigvec) = define_composite(Hd, DrHd, data->H(), data->dH());
+    std::tie(eigval, eigvec) = memoize(memo, key, [&]() {
+        return define_composite(Hd, DrHd, data->H(), data->dH(), memo.ordering);
+    });
     // compute fitting parameter gradient in composite prediction
     at::Tensor   Hc = tchem::linalg::UT_sy_U(  Hd, eigvec);
     at::Tensor DrHc = tchem::linalg::UT_sy_U(DrHd, eigvec);
     at::Tensor DcHc, DcDrHc;
-    std::tie(DcHc, DcDrHc) = Hderiva::DcHc_DcDxHc(Hc, DrHc,
+    std::tie(DcHc, DcDrHc) = Hderiva::block_DcHc_DcDxHc(Hc, DrHc,
         DrHd, DcHd, DcDrHd, eigval, eigvec);
     CL::utility::matrix<at::Tensor> DcSADQHc(NStates);
     for (size_t i = 0; i < NStates; i++)
@@ -125,22 +83,13 @@ at::Tensor & J, size_t & start) {
     }
 }
 
-inline void energy_Jacobian(const size_t & thread, const std::shared_ptr<Energy> & data,
+inline void energy_block_rows(const std::shared_ptr<Energy> & data,
+const at::Tensor & Hd, const std::vector<at::Tensor> & DcHd,
 at::Tensor & J, size_t & start) {
     // get energy and its gradient over fitting parameters
-    CL::utility::matrix<at::Tensor> x1s = data->x1s();
-    at::Tensor   Hd1 = Hdnet1s[thread]->forward(x1s);
-    at::Tensor DcHd1 = Hderiva::DcHd(Hd1, Hdnet1s[thread]->elements->parameters());
-    Hd1.detach_();
-    CL::utility::matrix<at::Tensor> x2s = data->x2s();
-    at::Tensor   Hd2 = Hdnet2s[thread]->forward(x2s);
-    at::Tensor DcHd2 = Hderiva::DcHd(Hd2, Hdnet2s[thread]->elements->parameters());
-    Hd2.detach_();
-    at::Tensor Hd = Hd1 + Hd2;
-    at::Tensor DcHd = at::cat({DcHd1, DcHd2}, -1);
     at::Tensor energy, states;
     std::tie(energy, states) = Hd.symeig(true);
-    at::Tensor DcHa = tchem::linalg::UT_sy_U(DcHd, states);
+    at::Tensor DcHa = Hderiva::UT_blocks_U(DcHd, states);
     // energy Jacobian
     at::Tensor J_E = unit * DcHa;
     for (size_t i = 0; i < data->NStates(); i++) {
@@ -149,33 +98,188 @@ at::Tensor & J, size_t & start) {
     }
 }
 
+// Each Hd element only depends on its own parameters, so d / dc is kept blockwise
+inline void reg_Jacobian(const size_t & thread, const std::shared_ptr<RegHam> & data,
+const size_t & key, Memo & memo, at::Tensor & J, size_t & start) {
+    at::Tensor Hd1, DrHd1, Hd2, DrHd2;
+    std::vector<at::Tensor> DcHd, DcDrHd, DcHd2, DcDrHd2;
+    std::tie(Hd1, DrHd1, DcHd , DcDrHd ) = Hdnet1s[thread]->forward_Dc_DcDx_blocks(data->x1s(), data->Jx1rTs());
+    std::tie(Hd2, DrHd2, DcHd2, DcDrHd2) = Hdnet2s[thread]->forward_Dc_DcDx_blocks(data->x2s(), data->Jx2rTs());
+    // combine both Hd networks, whose blocks cycle through the elements twice
+      DcHd.insert(  DcHd.end(),   DcHd2.begin(),   DcHd2.end());
+    DcDrHd.insert(DcDrHd.end(), DcDrHd2.begin(), DcDrHd2.end());
+    reg_block_rows(data, key, memo, Hd1 + Hd2, DrHd1 + DrHd2, DcHd, DcDrHd, J, start);
+}
+
+inline void deg_Jacobian(const size_t & thread, const std::shared_ptr<DegHam> & data,
+const size_t & key, Memo & memo, at::Tensor & J, size_t & start) {
+    at::Tensor Hd1, DrHd1, Hd2, DrHd2;
+    std::vector<at::Tensor> DcHd, DcDrHd, DcHd2, DcDrHd2;
+    std::tie(Hd1, DrHd1, DcHd , DcDrHd ) = Hdnet1s[thread]->forward_Dc_DcDx_blocks(data->x1s(), data->Jx1rTs());
+    std::tie(Hd2, DrHd2, DcHd2, DcDrHd2) = Hdnet2s[thread]->forward_Dc_DcDx_blocks(data->x2s(), data->Jx2rTs());
+      DcHd.insert(  DcHd.end(),   DcHd2.begin(),   DcHd2.end());
+    DcDrHd.insert(DcDrHd.end(), DcDrHd2.begin(), DcDrHd2.end());
+    deg_block_rows(data, key, memo, Hd1 + Hd2, DrHd1 + DrHd2, DcHd, DcDrHd, J, start);
+}
+
+inline void energy_Jacobian(const size_t & thread, const std::shared_ptr<Energy> & data,
+at::Tensor & J, size_t & start) {
+    at::Tensor Hd1, Hd2;
+    std::vector<at::Tensor> DcHd, DcHd2;
+    std::tie(Hd1, DcHd ) = Hdnet1s[thread]->forward_Dc_blocks(data->x1s());
+    std::tie(Hd2, DcHd2) = Hdnet2s[thread]->forward_Dc_blocks(data->x2s());
+    DcHd.insert(DcHd.end(), DcHd2.begin(), DcHd2.end());
+    energy_block_rows(data, Hd1 + Hd2, DcHd, J, start);
+}
+
+// JᵀJv of a data point without forming its Jacobian block:
+// Jv is obtained by feeding the rows with d / dc Hd . v and d / dc ▽Hd . v from forward mode,
+// then pulled back to the width-1 blocks by autograd over the (small) rows computation,
+// and finally to c by reverse mode through the networks
+template <typename T>
+void point_JTJv(const size_t & thread, const std::shared_ptr<T> & data,
+const std::function<void(const at::Tensor & Hd, const at::Tensor & DrHd,
+                         const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
+                         at::Tensor & J, size_t & start)> & rows,
+const at::Tensor & v, at::Tensor & JTJv) {
+    int64_t NPars1 = parameters1.numel();
+    at::Tensor Hd1, DrHd1, DcHd1_v, DcDrHd1_v, Hd2, DrHd2, DcHd2_v, DcDrHd2_v;
+    std::tie(Hd1, DrHd1, DcHd1_v, DcDrHd1_v) = Hdnet1s[thread]->forward_Dc_DcDx_jvp(data->x1s(), data->Jx1rTs(), v.slice(0, 0, NPars1));
+    std::tie(Hd2, DrHd2, DcHd2_v, DcDrHd2_v) = Hdnet2s[thread]->forward_Dc_DcDx_jvp(data->x2s(), data->Jx2rTs(), v.slice(0, NPars1));
+    at::Tensor   DcHd_v =   DcHd1_v +   DcHd2_v,
+               DcDrHd_v = DcDrHd1_v + DcDrHd2_v;
+    // the width-1 blocks, which autograd pulls the rows back to
+    int64_t N = DcHd_v.size(0), dim = DcDrHd_v.size(2);
+    std::vector<at::Tensor> DcHd, DcDrHd, blocks;
+    for (int64_t i = 0; i < N; i++)
+    for (int64_t j = i; j < N; j++) {
+          DcHd.push_back(  DcHd_v[i][j].view({1    }).clone().requires_grad_());
+        DcDrHd.push_back(DcDrHd_v[i][j].view({dim, 1}).clone().requires_grad_());
+    }
+    blocks.insert(blocks.end(),   DcHd.begin(),   DcHd.end());
+    blocks.insert(blocks.end(), DcDrHd.begin(), DcDrHd.end());
+    at::Tensor Jv = v.new_empty({(int64_t)count_rows(data), 1});
+    size_t start = 0;
+    rows(Hd1 + Hd2, DrHd1 + DrHd2, DcHd, DcDrHd, Jv, start);
+    // Jᵀ(Jv) over the blocks = d / d blocks (Jv . Jv / 2)
+    std::vector<at::Tensor> gs = torch::autograd::grad({0.5 * Jv.pow(2).sum()}, blocks, {}, false, false, true);
+    at::Tensor w = v.new_zeros({N, N}), W = v.new_zeros({N, N, dim});
+    size_t count = 0;
+    for (int64_t i = 0; i < N; i++)
+    for (int64_t j = i; j < N; j++) {
+        if (gs[count].defined()) w[i][j].copy_(gs[count][0]);
+        if (gs[count + DcHd.size()].defined()) W[i][j].copy_(gs[count + DcHd.size()].select(1, 0));
+        count++;
+    }
+    JTJv.slice(0, 0, NPars1) += Hdnet1s[thread]->forward_Dc_DcDx_vjp(data->x1s(), data->Jx1rTs(), w, W);
+    JTJv.slice(0, NPars1)    += Hdnet2s[thread]->forward_Dc_DcDx_vjp(data->x2s(), data->Jx2rTs(), w, W);
+}
+
 void Jacobian(double * JT, const double * c, const int32_t & M, const int32_t & N) {
     at::Tensor J = at::from_blob(JT, {N, M}, at::TensorOptions().dtype(torch::kFloat64));
     J.transpose_(0, 1);
+    size_t key = parameters_key(c, N);
+    c2p(c);
     #pragma omp parallel for
     for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
-        c2p(c, thread);
-        size_t start = segstart[thread];
-        for (const auto & data : regchunk[thread]) reg_Jacobian(thread, data, J, start);
-        for (const auto & data : degchunk[thread]) deg_Jacobian(thread, data, J, start);
-        for (const auto & data : energy_chunk[thread]) energy_Jacobian(thread, data, J, start);
+        // measure the cost of each data point for load balancing
+        for (size_t i = 0; i < regchunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            size_t start = regrows[thread][i];
+            reg_Jacobian(thread, regchunk[thread][i], key, regmemos[thread][i], J, start);
+            regcosts[thread][i] = omp_get_wtime() - time;
+        }
+        for (size_t i = 0; i < degchunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            size_t start = degrows[thread][i];
+            deg_Jacobian(thread, degchunk[thread][i], key, degmemos[thread][i], J, start);
+            degcosts[thread][i] = omp_get_wtime() - time;
+        }
+        for (size_t i = 0; i < energy_chunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            size_t start = energy_rows[thread][i];
+            energy_Jacobian(thread, energy_chunk[thread][i], J, start);
+            energy_costs[thread][i] = omp_get_wtime() - time;
+        }
     }
+    balance();
 }
 
-void regularized_Jacobian(double * JT, const double * c, const int32_t & M, const int32_t & N) {
-    at::Tensor J = at::from_blob(JT, {N, M}, at::TensorOptions().dtype(torch::kFloat64));
-    J.transpose_(0, 1);
+// Compute the Jacobian block of each data point, then hand it to `f` along with its first row
+// so that the full Jacobian never has to be stored
+void Jacobian_blocks(const double * c, const int32_t & N,
+const std::function<void(const size_t & thread, const at::Tensor & J, const size_t & start)> & f) {
+    c10::TensorOptions top = c10::TensorOptions().dtype(torch::kFloat64);
+    size_t key = parameters_key(c, N);
+    c2p(c);
+    #pragma omp parallel for
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
+        // measure the cost of each data point for load balancing
+        for (size_t i = 0; i < regchunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            at::Tensor J = at::empty({(int64_t)count_rows(regchunk[thread][i]), N}, top);
+            size_t start = 0;
+            reg_Jacobian(thread, regchunk[thread][i], key, regmemos[thread][i], J, start);
+            f(thread, J, regrows[thread][i]);
+            regcosts[thread][i] = omp_get_wtime() - time;
+        }
+        for (size_t i = 0; i < degchunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            at::Tensor J = at::empty({(int64_t)count_rows(degchunk[thread][i]), N}, top);
+            size_t start = 0;
+            deg_Jacobian(thread, degchunk[thread][i], key, degmemos[thread][i], J, start);
+            f(thread, J, degrows[thread][i]);
+            degcosts[thread][i] = omp_get_wtime() - time;
+        }
+        for (size_t i = 0; i < energy_chunk[thread].size(); i++) {
+            double time = omp_get_wtime();
+            at::Tensor J = at::empty({(int64_t)count_rows(energy_chunk[thread][i]), N}, top);
+            size_t start = 0;
+            energy_Jacobian(thread, energy_chunk[thread][i], J, start);
+            f(thread, J, energy_rows[thread][i]);
+            energy_costs[thread][i] = omp_get_wtime() - time;
+        }
+    }
+    balance();
+}
+
+// JᵀJv without ever forming J, see `point_JTJv`
+at::Tensor JTJv(const double * c, const int32_t & N, const at::Tensor & v) {
+    size_t key = parameters_key(c, N);
+    c2p(c);
+    std::vector<at::Tensor> JTJvs(OMP_NUM_THREADS);
     #pragma omp parallel for
     for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
-        c2p(c, thread);
-        size_t start = segstart[thread];
-        for (const auto & data : regchunk[thread]) reg_Jacobian(thread, data, J, start);
-        for (const auto & data : degchunk[thread]) deg_Jacobian(thread, data, J, start);
-        for (const auto & data : energy_chunk[thread]) energy_Jacobian(thread, data, J, start);
+        JTJvs[thread] = v.new_zeros(v.sizes());
+        for (size_t i = 0; i < regchunk[thread].size(); i++) {
+            Memo & memo = regmemos[thread][i];
+            point_JTJv<RegHam>(thread, regchunk[thread][i],
+                [&](const at::Tensor & Hd, const at::Tensor & DrHd,
+                    const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
+                    at::Tensor & J, size_t & start) {
+                    reg_block_rows(regchunk[thread][i], key, memo, Hd, DrHd, DcHd, DcDrHd, J, start);
+                }, v, JTJvs[thread]);
+        }
+        for (size_t i = 0; i < degchunk[thread].size(); i++) {
+            Memo & memo = degmemos[thread][i];
+            point_JTJv<DegHam>(thread, degchunk[thread][i],
+                [&](const at::Tensor & Hd, const at::Tensor & DrHd,
+                    const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
+                    at::Tensor & J, size_t & start) {
+                    deg_block_rows(degchunk[thread][i], key, memo, Hd, DrHd, DcHd, DcDrHd, J, start);
+                }, v, JTJvs[thread]);
+        }
+        for (size_t i = 0; i < energy_chunk[thread].size(); i++)
+        point_JTJv<Energy>(thread, energy_chunk[thread][i],
+            [&](const at::Tensor & Hd, const at::Tensor & DrHd,
+                const std::vector<at::Tensor> & DcHd, const std::vector<at::Tensor> & DcDrHd,
+                at::Tensor & J, size_t & start) {
+                energy_block_rows(energy_chunk[thread][i], Hd, DcHd, J, start);
+            }, v, JTJvs[thread]);
     }
-    at::Tensor regularization_block = J.slice(0, M - N, M);
-    regularization_block.fill_(0.0);
-    regularization_block.diagonal().copy_(regularization);
+    at::Tensor sum = JTJvs[0];
+    for (size_t thread = 1; thread < OMP_NUM_THREADS; thread++) sum += JTJvs[thread];
+    return sum;
 }
 
 } // namespace trust_region
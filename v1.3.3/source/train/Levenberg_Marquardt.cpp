@@ -0,0 +1,68 @@
+#include "Levenberg_Marquardt.hpp"
+
+namespace train { namespace trust_region {
+
+// Levenberg-Marquardt minimizing || r(c) ||^2 + || regularization * (c - prior) ||^2
+// The regularization rows are treated analytically rather than appended to the residue
+// Stop when the gradient vanishes, an accepted step reduces the loss by less than ftol relatively,
+// or the step is shorter than xtol relative to c
+void Levenberg_Marquardt(
+const std::function<void(double * r, const double * c, const int32_t & M, const int32_t & N)> & residue,
+const at::Tensor & regularization, const at::Tensor & prior,
+const std::function<void(const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D)> & linearize,
+const std::function<at::Tensor(const at::Tensor & g, const at::Tensor & D, const double & mu)> & solve,
+at::Tensor & c, const int32_t & NEqs, const size_t & max_iteration,
+const double & ftol, const double & xtol) {
+    int32_t NPars = c.size(0);
+    at::Tensor r = c.new_empty(NEqs);
+    // the square of the regularized residue 2-norm
+    auto loss = [&](const at::Tensor & c) -> double {
+        residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+        at::Tensor r_reg = regularization * (c - prior);
+        return r.dot(r).item<double>() + r_reg.dot(r_reg).item<double>();
+    };
+    double f = loss(c);
+    at::Tensor g, D;
+    linearize(c, r, g, D);
+    double mu = 1e-3, nu = 2.0;
+    std::cout << "Levenberg-Marquardt iteration 0: regularized residue = " << sqrt(f) << std::endl;
+    for (size_t iteration = 1; iteration <= max_iteration; iteration++) {
+        if (g.norm().item<double>() < 1e-15) break;
+        // a parameter with neither data nor regularization should not blow up the step
+        at::Tensor step = solve(g, D.clamp_min(1e-12), mu);
+        if (! step.defined()) {
+            mu *= nu;
+            nu *= 2.0;
+            std::cout << "Levenberg-Marquardt iteration " << iteration
+                      << ": the step is singular, damping = " << mu << std::endl;
+            if (mu > 1e15) break;
+            continue;
+        }
+        at::Tensor c_new = c + step;
+        double f_new = loss(c_new);
+        // reduction predicted by the linearized residue
+        double predicted = - g.dot(step).item<double>() + mu * (step * D * step).sum().item<double>();
+        double rho = predicted > 0.0 ? (f - f_new) / predicted : -1.0;
+        bool converged = false;
+        if (rho > 0.0) {
+            converged = f - f_new < ftol * f;
+            c = c_new;
+            f = f_new;
+            // `loss` has left the residue at the new c in r
+            linearize(c, r, g, D);
+            mu *= std::max(1.0 / 3.0, 1.0 - pow(2.0 * rho - 1.0, 3));
+            nu = 2.0;
+        }
+        else {
+            mu *= nu;
+            nu *= 2.0;
+        }
+        std::cout << "Levenberg-Marquardt iteration " << iteration
+                  << ": regularized residue = " << sqrt(f)
+                  << ", damping = " << mu << std::endl;
+        if (converged || step.norm().item<double>() < xtol * (c.norm().item<double>() + xtol) || mu > 1e15) break;
+    }
+}
+
+} // namespace trust_region
+} // namespace train
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef train_Levenberg_Marquardt_hpp
+#define train_Levenberg_Marquardt_hpp
+
+#include <functional>
+
+#include <torch/torch.h>
+
+namespace train { namespace trust_region {
+
+// Levenberg-Marquardt minimizing || r(c) ||^2 + || regularization * (c - prior) ||^2
+// for the solvers that do not hand a regularized Jacobian to Foptim
+// The regularization rows are treated analytically rather than appended to the residue
+// `residue` writes the data residue r(c) of NEqs rows
+// `linearize` takes c and the residue at c, returns the gradient Jᵀr and the diagonal of JᵀJ,
+//     both including the regularization contribution
+// `solve` takes Jᵀr, diag(JᵀJ) and the damping μ, returns the step δ solving
+//     (JᵀJ + μ diag(JᵀJ)) δ = -Jᵀr
+//     or an undefined tensor if that fails (e.g. numerically singular), then μ is raised
+// Stop when the gradient vanishes, an accepted step reduces the loss by less than ftol relatively,
+// or the step is shorter than xtol relative to c
+void Levenberg_Marquardt(
+const std::function<void(double * r, const double * c, const int32_t & M, const int32_t & N)> & residue,
+const at::Tensor & regularization, const at::Tensor & prior,
+const std::function<void(const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D)> & linearize,
+const std::function<at::Tensor(const at::Tensor & g, const at::Tensor & D, const double & mu)> & solve,
+at::Tensor & c, const int32_t & NEqs, const size_t & max_iteration,
+const double & ftol = 1e-8, const double & xtol = 1e-8);
+
+} // namespace trust_region
+} // namespace train
+
+#endif
@@ -4,19 +4,41 @@ namespace train {
 
 int64_t NStates;
 
-std::shared_ptr<tchem::chem::Orderer> orderer;
-
 size_t OMP_NUM_THREADS;
 
 // each thread owns a copy of Hd network
 // thread 0 shares the original Hdnet
 std::vector<std::shared_ptr<obnet::symat>> Hdnet1s, Hdnet2s;
 
+// the parameters of every copy of Hdnet1 (Hdnet2) alias the flat buffer parameters1 (parameters2)
+// 2 buffers rather than 1, so that saving Hdnet1 does not carry the storage of Hdnet2 and vice versa
+at::Tensor parameters1, parameters2;
+
+namespace {
+
+// concatenate the parameters of Hdnet into a flat buffer
+at::Tensor flatten_parameters(const std::shared_ptr<obnet::symat> & Hdnet) {
+    std::vector<at::Tensor> ps;
+    for (const at::Tensor & p : Hdnet->elements->parameters()) ps.push_back(p.detach().view(-1));
+    return at::cat(ps);
+}
+
+// let the parameters of Hdnet alias consecutive segments of buffer
+void alias_parameters(const std::shared_ptr<obnet::symat> & Hdnet, const at::Tensor & buffer) {
+    torch::NoGradGuard no_grad;
+    int64_t start = 0;
+    for (const at::Tensor & p : Hdnet->elements->parameters()) {
+        int64_t stop = start + p.numel();
+        p.set_data(buffer.slice(0, start, stop).view(p.sizes()));
+        start = stop;
+    }
+}
+
+}
+
 void initialize() {
     NStates = Hdnet1->NStates();
 
-    orderer = std::make_shared<tchem::chem::Orderer>(NStates);
-
     OMP_NUM_THREADS = omp_get_max_threads();
     std::cout << "The number of threads = " << OMP_NUM_THREADS << "\n\n";
 
@@ -30,6 +52,13 @@ void initialize() {
         Hdnet2s[i] = std::make_shared<obnet::symat>(Hdnet2);
         Hdnet2s[i]->train();
     }
+
+    parameters1 = flatten_parameters(Hdnet1);
+    parameters2 = flatten_parameters(Hdnet2);
+    for (size_t i = 0; i < OMP_NUM_THREADS; i++) {
+        alias_parameters(Hdnet1s[i], parameters1);
+        alias_parameters(Hdnet2s[i], parameters2);
+    }
 }
 
 } // namespace train
@@ -48,113 +77,241 @@ std::vector<std::vector<std::shared_ptr<RegHam>>> regchunk;
 std::vector<std::vector<std::shared_ptr<DegHam>>> degchunk;
 std::vector<std::vector<std::shared_ptr<Energy>>> energy_chunk;
 
-// Each thread works on a segment of residue or Jacobian
-// Thread i works on rows [segstart[i], segstart[i + 1])
-std::vector<size_t> segstart;
+// Each data point works on a segment of residue or Jacobian rows,
+// regrows[thread][i] is the first row of regchunk[thread][i], so as degrows and energy_rows
+// The rows are ordered as regset, degset, energy_set regardless of the chunking
+std::vector<std::vector<size_t>> regrows, degrows, energy_rows;
 
-void initialize(
-const std::shared_ptr<abinitio::DataSet<RegHam>> & _regset,
-const std::shared_ptr<abinitio::DataSet<DegHam>> & _degset,
-const std::shared_ptr<abinitio::DataSet<Energy>> & _energy_set) {
-    regset = _regset->examples();
-    degset = _degset->examples();
-    energy_set = _energy_set->examples();
+// The cost of each data point, initially estimated then measured by `Jacobian`
+// regcosts[thread][i] is the cost of regchunk[thread][i], so as degcosts and energy_costs
+std::vector<std::vector<double>> regcosts, degcosts, energy_costs;
 
-    regchunk.resize(OMP_NUM_THREADS);
-    degchunk.resize(OMP_NUM_THREADS);
-    energy_chunk.resize(OMP_NUM_THREADS);
-    size_t regchunksize = regset.size() / OMP_NUM_THREADS,
-           degchunksize = degset.size() / OMP_NUM_THREADS,
-           energy_chunksize = energy_set.size() / OMP_NUM_THREADS;
-    size_t regcount = 0, degcount = 0, energy_count = 0;
-    // the leading threads may have 1 more data point
-    size_t leading_regthreads   = regset.size() % OMP_NUM_THREADS,
-           leading_regchunksize = regchunksize + 1;
-    for (size_t thread = 0; thread < leading_regthreads; thread++) {
-        regchunk[thread].resize(leading_regchunksize);
-        for (size_t i = 0; i < leading_regchunksize; i++) {
-            regchunk[thread][i] = regset[regcount];
-            regcount++;
-        }
-    }
-    size_t leading_degthreads   = degset.size() % OMP_NUM_THREADS,
-           leading_degchunksize = degchunksize + 1;
-    for (size_t thread = 0; thread < leading_degthreads; thread++) {
-        degchunk[thread].resize(leading_degchunksize);
-        for (size_t i = 0; i < leading_degchunksize; i++) {
-            degchunk[thread][i] = degset[degcount];
-            degcount++;
-        }
-    }
-    size_t leading_energy_threads   = energy_set.size() % OMP_NUM_THREADS,
-           leading_energy_chunksize = energy_chunksize + 1;
-    for (size_t thread = 0; thread < leading_energy_threads; thread++) {
-        energy_chunk[thread].resize(leading_energy_chunksize);
-        for (size_t i = 0; i < leading_energy_chunksize; i++) {
-            energy_chunk[thread][i] = energy_set[energy_count];
-            energy_count++;
-        }
-    }
-    // the remaining threads each has `chunk size` data points
-    for (size_t thread = leading_regthreads; thread < OMP_NUM_THREADS; thread++) {
-        regchunk[thread].resize(regchunksize);
-        for (size_t i = 0; i < regchunksize; i++) {
-            regchunk[thread][i] = regset[regcount];
-            regcount++;
-        }
+// If enabled, each thread packs its chunk of data into a contiguous arena
+std::vector<at::Tensor> arenas;
+
+// regmemos[thread][i] memoizes regchunk[thread][i], so as degmemos
+std::vector<std::vector<Memo>> regmemos, degmemos;
+
+namespace {
+
+// the parameters of the latest `parameters_key` call and their generation
+std::vector<double> last_parameters;
+size_t generation = 0;
+
+}
+
+// A new generation whenever c differs from the last call bitwise,
+// so that a same c is recognized exactly rather than by a hash
+size_t parameters_key(const double * c, const int32_t & N) {
+    if ((int32_t)last_parameters.size() != N
+    || std::memcmp(last_parameters.data(), c, N * sizeof(double)) != 0) {
+        last_parameters.assign(c, c + N);
+        generation++;
     }
-    for (size_t thread = leading_degthreads; thread < OMP_NUM_THREADS; thread++) {
-        degchunk[thread].resize(degchunksize);
-        for (size_t i = 0; i < degchunksize; i++) {
-            degchunk[thread][i] = degset[degcount];
-            degcount++;
-        }
+    return generation;
+}
+
+// the rows of a data point in residue or Jacobian
+size_t count_rows(const std::shared_ptr<RegHam> & data) {
+    size_t NStates_data = data->NStates();
+    // energy least square equations
+    size_t rows = NStates_data;
+    // (▽H)a least square equations
+    for (size_t i = 0; i < NStates_data; i++)
+    for (size_t j = i; j < NStates_data; j++)
+    rows += data->SAdH(i, j).size(0);
+    return rows;
+}
+size_t count_rows(const std::shared_ptr<DegHam> & data) {
+    size_t rows = 0;
+    // Hc least square equations
+    for (size_t i = 0; i < NStates; i++)
+    for (size_t j = i; j < NStates; j++)
+    if (data->irreds(i, j) == 0) rows++;
+    // (▽H)c least square equations
+    for (size_t i = 0; i < NStates; i++)
+    for (size_t j = i; j < NStates; j++)
+    rows += data->SAdH(i, j).size(0);
+    return rows;
+}
+size_t count_rows(const std::shared_ptr<Energy> & data) {
+    // energy least square equations
+    return data->NStates();
+}
+
+namespace {
+
+// A rough cost model before any measurement:
+// the network evaluation scales as NStates^2 x (1 + the number of Cartesian coordinates) for ▽Hd,
+// a composite data point roughly doubles that due to 2 commutators and the dH . dH eigenvalue problem,
+// an energy-only data point needs only Hd
+double estimate_cost(const std::shared_ptr<RegHam> & data) {
+    return NStates * NStates * (1.0 + data->cartdim()) + count_rows(data);
+}
+double estimate_cost(const std::shared_ptr<DegHam> & data) {
+    return 2.0 * NStates * NStates * (1.0 + data->cartdim()) + count_rows(data);
+}
+double estimate_cost(const std::shared_ptr<Energy> & data) {
+    return NStates * NStates + count_rows(data);
+}
+
+// the first row of each data point in regset, degset, energy_set
+std::vector<size_t> regstart, degstart, energy_start;
+
+// regindices[thread][i] is the index of regchunk[thread][i] in regset, so as degindices and energy_indices
+std::vector<std::vector<size_t>> regindices, degindices, energy_indices;
+
+// Let each thread copy its chunk of data into an arena in the order of residue and Jacobian evaluation
+// The owning thread touches its arena first, so the arena is allocated on its NUMA node
+void pack_arenas() {
+    arenas.resize(OMP_NUM_THREADS);
+    #pragma omp parallel for
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
+        size_t size = 0;
+        for (const auto & data : regchunk[thread]) size += data->arena_size();
+        for (const auto & data : degchunk[thread]) size += data->arena_size();
+        for (const auto & data : energy_chunk[thread]) size += data->arena_size();
+        arenas[thread] = at::empty(size, c10::TensorOptions().dtype(torch::kFloat64));
+        size_t offset = 0;
+        for (const auto & data : regchunk[thread]) data->move_to_arena_(arenas[thread], offset);
+        for (const auto & data : degchunk[thread]) data->move_to_arena_(arenas[thread], offset);
+        for (const auto & data : energy_chunk[thread]) data->move_to_arena_(arenas[thread], offset);
     }
-    for (size_t thread = leading_energy_threads; thread < OMP_NUM_THREADS; thread++) {
-        energy_chunk[thread].resize(energy_chunksize);
-        for (size_t i = 0; i < energy_chunksize; i++) {
-            energy_chunk[thread][i] = energy_set[energy_count];
-            energy_count++;
+    size_t size = 0;
+    for (const at::Tensor & arena : arenas) size += arena.numel();
+    std::cout << "Packed the data into per-thread arenas of "
+              << (double)(size * sizeof(double)) / 1024.0 / 1024.0 << " MB in total\n\n";
+}
+
+// Distribute the data points to threads given their costs,
+// by the longest-processing-time-first greedy algorithm
+void distribute(const std::vector<double> & regcost, const std::vector<double> & degcost, const std::vector<double> & energy_cost) {
+    // (cost, type, index), type 0 = regular, 1 = degenerate, 2 = energy-only
+    std::vector<std::tuple<double, size_t, size_t>> tasks;
+    tasks.reserve(regset.size() + degset.size() + energy_set.size());
+    for (size_t i = 0; i < regset.size(); i++) tasks.emplace_back(regcost[i], 0, i);
+    for (size_t i = 0; i < degset.size(); i++) tasks.emplace_back(degcost[i], 1, i);
+    for (size_t i = 0; i < energy_set.size(); i++) tasks.emplace_back(energy_cost[i], 2, i);
+    std::stable_sort(tasks.begin(), tasks.end(),
+        [](const std::tuple<double, size_t, size_t> & a, const std::tuple<double, size_t, size_t> & b) {
+            return std::get<0>(a) > std::get<0>(b);
+        });
+    regindices.assign(OMP_NUM_THREADS, {});
+    degindices.assign(OMP_NUM_THREADS, {});
+    energy_indices.assign(OMP_NUM_THREADS, {});
+    std::vector<double> loads(OMP_NUM_THREADS, 0.0);
+    for (const auto & task : tasks) {
+        size_t thread = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        loads[thread] += std::get<0>(task);
+        switch (std::get<1>(task)) {
+            case 0: regindices[thread].push_back(std::get<2>(task)); break;
+            case 1: degindices[thread].push_back(std::get<2>(task)); break;
+            case 2: energy_indices[thread].push_back(std::get<2>(task)); break;
         }
     }
-
-    segstart.resize(OMP_NUM_THREADS);
-    segstart[0] = 0;
-    for (size_t thread = 1; thread < OMP_NUM_THREADS; thread++) {
-        segstart[thread] = segstart[thread - 1];
-        for (const auto & data : regchunk[thread - 1]) {
-            size_t NStates_data = data->NStates();
-            // energy least square equations
-            segstart[thread] += NStates_data;
-            // (▽H)a least square equations
-            for (size_t i = 0; i < NStates_data; i++)
-            for (size_t j = i; j < NStates_data; j++)
-            segstart[thread] += data->SAdH(i, j).size(0);
+    // within a thread keep the original order, which is also the order of rows
+    regchunk.assign(OMP_NUM_THREADS, {});
+    degchunk.assign(OMP_NUM_THREADS, {});
+    energy_chunk.assign(OMP_NUM_THREADS, {});
+    regrows.assign(OMP_NUM_THREADS, {});
+    degrows.assign(OMP_NUM_THREADS, {});
+    energy_rows.assign(OMP_NUM_THREADS, {});
+    regcosts.assign(OMP_NUM_THREADS, {});
+    degcosts.assign(OMP_NUM_THREADS, {});
+    energy_costs.assign(OMP_NUM_THREADS, {});
+    // the memos follow the chunks, so are discarded on redistribution
+    regmemos.assign(OMP_NUM_THREADS, {});
+    degmemos.assign(OMP_NUM_THREADS, {});
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
+        std::sort(regindices[thread].begin(), regindices[thread].end());
+        for (const size_t & index : regindices[thread]) {
+            regchunk[thread].push_back(regset[index]);
+            regrows [thread].push_back(regstart[index]);
+            regcosts[thread].push_back(regcost[index]);
         }
-        for (const auto & data : degchunk[thread - 1]) {
-            // Hc least square equations
-            for (size_t i = 0; i < NStates; i++)
-            for (size_t j = i; j < NStates; j++)
-            if (data->irreds(i, j) == 0) segstart[thread]++;
-            // (▽H)c least square equations
-            for (size_t i = 0; i < NStates; i++)
-            for (size_t j = i; j < NStates; j++)
-            segstart[thread] += data->SAdH(i, j).size(0);
+        std::sort(degindices[thread].begin(), degindices[thread].end());
+        for (const size_t & index : degindices[thread]) {
+            degchunk[thread].push_back(degset[index]);
+            degrows [thread].push_back(degstart[index]);
+            degcosts[thread].push_back(degcost[index]);
         }
-        for (const auto & data : energy_chunk[thread - 1]) {
-            // energy least square equations
-            segstart[thread] += data->NStates();
+        regmemos[thread].resize(regchunk[thread].size());
+        degmemos[thread].resize(degchunk[thread].size());
+        std::sort(energy_indices[thread].begin(), energy_indices[thread].end());
+        for (const size_t & index : energy_indices[thread]) {
+            energy_chunk[thread].push_back(energy_set[index]);
+            energy_rows [thread].push_back(energy_start[index]);
+            energy_costs[thread].push_back(energy_cost[index]);
         }
     }
 
+    double max_load = *std::max_element(loads.begin(), loads.end());
+    if (max_load <= 0.0) max_load = 1.0;
     for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
         std::cout << "Thread " << thread + 1 << ":\n"
                   << "* owns " << regchunk[thread].size() << " adiabatic data points\n"
                   << "* owns " << degchunk[thread].size() << " composite data points\n"
                   << "* owns " << energy_chunk[thread].size() << " energy-only data points\n"
-                  << "* starts with Jacobian row " << segstart[thread] << '\n';
+                  << "* relative load " << loads[thread] / max_load << '\n';
     }
     std::cout << '\n';
+
+    if (! arenas.empty()) pack_arenas();
+}
+
+// whether the chunks have been rebalanced by measured costs
+bool balanced = false;
+
+}
+
+// Rebalance the chunks by the costs measured in the 1st `Jacobian` call, only once
+void balance() {
+    if (balanced) return;
+    std::vector<double> regcost(regset.size()), degcost(degset.size()), energy_cost(energy_set.size());
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
+        for (size_t i = 0; i < regchunk[thread].size(); i++) regcost[regindices[thread][i]] = regcosts[thread][i];
+        for (size_t i = 0; i < degchunk[thread].size(); i++) degcost[degindices[thread][i]] = degcosts[thread][i];
+        for (size_t i = 0; i < energy_chunk[thread].size(); i++) energy_cost[energy_indices[thread][i]] = energy_costs[thread][i];
+    }
+    std::cout << "Rebalancing the data among threads by measured cost\n";
+    distribute(regcost, degcost, energy_cost);
+    balanced = true;
+}
+
+void initialize(
+const std::shared_ptr<abinitio::DataSet<RegHam>> & _regset,
+const std::shared_ptr<abinitio::DataSet<DegHam>> & _degset,
+const std::shared_ptr<abinitio::DataSet<Energy>> & _energy_set,
+const bool & contiguous) {
+    regset = _regset->examples();
+    degset = _degset->examples();
+    energy_set = _energy_set->examples();
+
+    // row-offset table
+    size_t row = 0;
+    regstart.resize(regset.size());
+    for (size_t i = 0; i < regset.size(); i++) {
+        regstart[i] = row;
+        row += count_rows(regset[i]);
+    }
+    degstart.resize(degset.size());
+    for (size_t i = 0; i < degset.size(); i++) {
+        degstart[i] = row;
+        row += count_rows(degset[i]);
+    }
+    energy_start.resize(energy_set.size());
+    for (size_t i = 0; i < energy_set.size(); i++) {
+        energy_start[i] = row;
+        row += count_rows(energy_set[i]);
+    }
+
+    // distribute the data by estimated cost until `Jacobian` measures them
+    std::vector<double> regcost(regset.size()), degcost(degset.size()), energy_cost(energy_set.size());
+    for (size_t i = 0; i < regset.size(); i++) regcost[i] = estimate_cost(regset[i]);
+    for (size_t i = 0; i < degset.size(); i++) degcost[i] = estimate_cost(degset[i]);
+    for (size_t i = 0; i < energy_set.size(); i++) energy_cost[i] = estimate_cost(energy_set[i]);
+    if (contiguous) arenas.resize(OMP_NUM_THREADS);
+    distribute(regcost, degcost, energy_cost);
 }
 
 } // namespace trust_region
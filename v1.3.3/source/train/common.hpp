@@ -1,76 +1,65 @@
 #ifndef train_common_hpp
 #define train_common_hpp
 
+#include <functional>
+
 #include <tchem/linalg.hpp>
-#include <tchem/chemistry.hpp>
 
 #include "../../include/global.hpp"
 
+#include "ordering.hpp"
+
 namespace train {
 
 extern int64_t NStates;
 
-extern std::shared_ptr<tchem::chem::Orderer> orderer;
-
 extern size_t OMP_NUM_THREADS;
 
 // each thread owns a copy of Hd network
 // thread 0 shares the original Hdnet
 extern std::vector<std::shared_ptr<obnet::symat>> Hdnet1s, Hdnet2s;
 
-inline void p2c(const size_t & thread, double * c) {
-    size_t count = 0;
-    for (const at::Tensor & p : Hdnet1s[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(&(c[count]), p.data_ptr<double>(), numel * sizeof(double));
-        count += numel;
-    }
-    for (const at::Tensor & p : Hdnet2s[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(&(c[count]), p.data_ptr<double>(), numel * sizeof(double));
-        count += numel;
-    }
+// the parameters of every copy of Hdnet1 (Hdnet2) alias the flat buffer parameters1 (parameters2),
+// so c only has to be copied once rather than once per thread
+// (autograd states, e.g. gradients, remain thread private)
+extern at::Tensor parameters1, parameters2;
+
+inline void p2c(double * c) {
+    size_t NPars1 = parameters1.numel();
+    std::memcpy(c, parameters1.data_ptr<double>(), NPars1 * sizeof(double));
+    std::memcpy(&(c[NPars1]), parameters2.data_ptr<double>(), parameters2.numel() * sizeof(double));
 }
-inline void c2p(const double * c, const size_t & thread) {
-    torch::NoGradGuard no_grad;
-    size_t count = 0;
-    for (const at::Tensor & p : Hdnet1s[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(p.data_ptr<double>(), &(c[count]), numel * sizeof(double));
-        count += numel;
-    }
-    for (const at::Tensor & p : Hdnet2s[thread]->elements->parameters()) {
-        size_t numel = p.numel();
-        std::memcpy(p.data_ptr<double>(), &(c[count]), numel * sizeof(double));
-        count += numel;
-    }
+inline void c2p(const double * c) {
+    size_t NPars1 = parameters1.numel();
+    std::memcpy(parameters1.data_ptr<double>(), c, NPars1 * sizeof(double));
+    std::memcpy(parameters2.data_ptr<double>(), &(c[NPars1]), parameters2.numel() * sizeof(double));
 }
 
+// `ordering` is the previous choice on input, which speeds up the search, and the new choice on output
 inline std::tuple<at::Tensor, at::Tensor> define_adiabatz(
 const at::Tensor & Hd, const at::Tensor & DrHd,
-const int64_t & NStates_data, const at::Tensor & DrHa_data) {
+const at::Tensor & DrHa_data, Ordering & ordering) {
     at::Tensor energy, states;
     std::tie(energy, states) = Hd.symeig(true);
     at::Tensor DrHa = tchem::linalg::UT_sy_U(DrHd, states);
-    size_t ipermutation, iphase;
-    std::tie(ipermutation, iphase) = orderer->ipermutation_iphase_min(DrHa, DrHa_data);
-    orderer->alter_eigvals_(energy, ipermutation);
-    orderer->alter_states_(states, ipermutation, NStates_data, iphase);
+    ordering = order_states(DrHa, DrHa_data, ordering);
+    alter_(energy, states, ordering);
     return std::make_tuple(energy, states);
 }
 
+// `ordering` is the previous choice on input, which speeds up the search, and the new choice on output
 inline std::tuple<at::Tensor, at::Tensor> define_composite(
 const at::Tensor & Hd, const at::Tensor & DrHd,
-const at::Tensor & Hc_data, const at::Tensor & DrHc_data) {
+const at::Tensor & Hc_data, const at::Tensor & DrHc_data, Ordering & ordering) {
     at::Tensor dHdH = tchem::linalg::sy3matdotmul(DrHd, DrHd);
     at::Tensor eigval, eigvec;
     std::tie(eigval, eigvec) = dHdH.symeig(true);
     at::Tensor   Hc = tchem::linalg::UT_sy_U(  Hd, eigvec),
                DrHc = tchem::linalg::UT_sy_U(DrHd, eigvec);
-    size_t ipermutation, iphase;
-    std::tie(ipermutation, iphase) = orderer->ipermutation_iphase_min(Hc, DrHc, Hc_data, DrHc_data, unit_square);
-    orderer->alter_eigvals_(eigval, ipermutation);
-    orderer->alter_states_(eigvec, ipermutation, NStates, iphase);
+    // weight Hc by unit so that it is commensurate with (▽H)c
+    ordering = order_states(at::cat({unit * Hc.unsqueeze(-1), DrHc}, -1),
+                            at::cat({unit * Hc_data.unsqueeze(-1), DrHc_data}, -1), ordering);
+    alter_(eigval, eigvec, ordering);
     return std::make_tuple(eigval, eigvec);
 }
 
@@ -90,9 +79,53 @@ extern std::vector<std::vector<std::shared_ptr<RegHam>>> regchunk;
 extern std::vector<std::vector<std::shared_ptr<DegHam>>> degchunk;
 extern std::vector<std::vector<std::shared_ptr<Energy>>> energy_chunk;
 
-// Each thread works on a segment of residue or Jacobian
-// Thread i works on rows [segstart[i], segstart[i + 1])
-extern std::vector<size_t> segstart;
+// the rows of a data point in residue or Jacobian
+size_t count_rows(const std::shared_ptr<RegHam> & data);
+size_t count_rows(const std::shared_ptr<DegHam> & data);
+size_t count_rows(const std::shared_ptr<Energy> & data);
+
+// Each data point works on a segment of residue or Jacobian rows,
+// regrows[thread][i] is the first row of regchunk[thread][i], so as degrows and energy_rows
+// The rows are ordered as regset, degset, energy_set regardless of the chunking
+extern std::vector<std::vector<size_t>> regrows, degrows, energy_rows;
+
+// The cost of each data point, initially estimated then measured by `Jacobian`
+// regcosts[thread][i] is the cost of regchunk[thread][i], so as degcosts and energy_costs
+extern std::vector<std::vector<double>> regcosts, degcosts, energy_costs;
+
+// If enabled, each thread packs its chunk of data into a contiguous arena
+extern std::vector<at::Tensor> arenas;
+
+// The representation of a data point, i.e. eigenvalues and eigenvectors after fixing permutation and phase,
+// memoized so that `residue` and `Jacobian` at a same c define it only once
+// The ordering is kept across parameters as the starting incumbent of the next search
+struct Memo {
+    size_t key = 0;
+    at::Tensor eigval, eigvec;
+    Ordering ordering;
+};
+
+// regmemos[thread][i] memoizes regchunk[thread][i], so as degmemos
+// energy-only data points need no phase fixing so are not memoized
+extern std::vector<std::vector<Memo>> regmemos, degmemos;
+
+// The key of memoized representations, which changes whenever the parameters change
+// Must be called outside parallel regions
+size_t parameters_key(const double * c, const int32_t & N);
+
+// Return the memoized representation if it was defined at the parameters of `key`,
+// otherwise define it and memoize
+inline std::tuple<at::Tensor, at::Tensor> memoize(Memo & memo, const size_t & key,
+const std::function<std::tuple<at::Tensor, at::Tensor>()> & define) {
+    if (memo.key != key || ! memo.eigvec.defined()) {
+        std::tie(memo.eigval, memo.eigvec) = define();
+        memo.key = key;
+    }
+    return std::make_tuple(memo.eigval, memo.eigvec);
+}
+
+// Rebalance the chunks by the costs measured in the 1st `Jacobian` call, only once
+void balance();
 
 } // namespace trust_region
 } // namespace train
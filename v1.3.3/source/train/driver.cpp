@@ -1,8 +1,9 @@
-#include <Foptim/Foptim.hpp>
+#include <functional>
 
-#include <CppLibrary/linalg.hpp>
+#include <Foptim/Foptim.hpp>
 
 #include "common.hpp"
+#include "Levenberg_Marquardt.hpp"
 
 namespace train { namespace trust_region {
 
@@ -47,31 +48,53 @@ std::tuple<int32_t, int32_t> count_eq_par() {
 void residue (double *  r, const double * c, const int32_t & M, const int32_t & N);
 void Jacobian(double * JT, const double * c, const int32_t & M, const int32_t & N);
 
-void regularized_residue (double *  r, const double * c, const int32_t & M, const int32_t & N);
-void regularized_Jacobian(double * JT, const double * c, const int32_t & M, const int32_t & N);
+at::Tensor conjugate_gradient(const std::function<at::Tensor(const at::Tensor &)> & A,
+const at::Tensor & b, const at::Tensor & diagA,
+const size_t & max_iteration, const double & tolerance);
 
-void optimize(const size_t & max_iteration) {
+// Train with the dense Jacobian of the data rows only
+// Without regularization that is the whole problem, which Foptim handles as before
+// Foptim's trust region only takes residue rows, so with regularization it would need the NPars extra rows,
+// instead the regularization enters analytically as JᵀJ + diag(λ²) and Jᵀr + λ²(c - prior),
+// and the Levenberg-Marquardt step is solved by conjugate gradient on products with the stored J,
+// so nothing beyond the NEqs x NPars Jacobian is ever allocated
+void optimize(const size_t & max_iteration, const size_t & max_CG_iteration) {
     int32_t NEqs, NPars;
     std::tie(NEqs, NPars) = count_eq_par();
 
-    double * c = new double[NPars];
-    p2c(0, c);
-    // Display initial residue
-    double * r = new double[NEqs];
-    residue(r, c, NEqs, NPars);
-    std::cout << "The initial residue = " << CL::linalg::norm2(r, NEqs) << std::endl;
-    delete [] r;
+    at::Tensor c = regularization.new_empty(NPars);
+    p2c(c.data_ptr<double>());
+    at::Tensor r = c.new_empty(NEqs);
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The initial residue = " << r.norm().item<double>() << std::endl;
 
-    Foptim::trust_region_verbose(regularized_residue, regularized_Jacobian,
-                                 c, NEqs + NPars, NPars,
-                                 max_iteration);
-    c2p(c, 0);
+    if (regularization.abs().max().item<double>() == 0.0) {
+        Foptim::trust_region_verbose(residue, Jacobian,
+                                     c.data_ptr<double>(), NEqs, NPars,
+                                     max_iteration);
+    }
+    else {
+        at::Tensor reg_square = regularization * regularization;
+        // `Jacobian` writes Jᵀ, i.e. J in column-major order
+        at::Tensor JT = c.new_empty({NPars, NEqs});
+        auto linearize = [&](const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D) {
+            Jacobian(JT.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+            g = JT.mv(r) + reg_square * (c - prior);
+            // diag(JᵀJ) as row-wise dot products of Jᵀ, without an elementwise copy of J
+            D = at::einsum("pe,pe->p", {JT, JT}) + reg_square;
+        };
+        auto solve = [&](const at::Tensor & g, const at::Tensor & D, const double & mu) {
+            auto A = [&](const at::Tensor & v) {
+                return JT.mv(JT.t().mv(v)) + (reg_square + mu * D) * v;
+            };
+            return conjugate_gradient(A, -g, (1.0 + mu) * D, max_CG_iteration, 1e-3);
+        };
+        Levenberg_Marquardt(residue, regularization, prior, linearize, solve, c, NEqs, max_iteration);
+    }
+    c2p(c.data_ptr<double>());
 
-    r = new double[NEqs];
-    residue(r, c, NEqs, NPars);
-    std::cout << "The final residue = " << CL::linalg::norm2(r, NEqs) << '\n';
-    delete [] r;
-    delete [] c;
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The final residue = " << r.norm().item<double>() << '\n';
 }
 
 } // namespace trust_region
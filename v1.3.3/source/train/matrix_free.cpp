@@ -0,0 +1,110 @@
+#include <functional>
+
+#include "common.hpp"
+#include "Levenberg_Marquardt.hpp"
+
+namespace train { namespace trust_region {
+
+std::tuple<int32_t, int32_t> count_eq_par();
+
+void residue(double * r, const double * c, const int32_t & M, const int32_t & N);
+
+void Jacobian_blocks(const double * c, const int32_t & N,
+const std::function<void(const size_t & thread, const at::Tensor & J, const size_t & start)> & f);
+
+at::Tensor JTJv(const double * c, const int32_t & N, const at::Tensor & v);
+
+namespace {
+
+// Each thread accumulates its own share of a product, then reduce
+at::Tensor reduce(const std::vector<at::Tensor> & partials) {
+    at::Tensor sum = partials[0].clone();
+    for (size_t thread = 1; thread < partials.size(); thread++) sum += partials[thread];
+    return sum;
+}
+
+// Jᵀr and diag(JᵀJ) of the data rows
+void data_gradient(const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D) {
+    std::vector<at::Tensor> gs(OMP_NUM_THREADS), Ds(OMP_NUM_THREADS);
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
+        gs[thread] = c.new_zeros(c.sizes());
+        Ds[thread] = c.new_zeros(c.sizes());
+    }
+    Jacobian_blocks(c.data_ptr<double>(), c.size(0),
+        [&](const size_t & thread, const at::Tensor & J, const size_t & start) {
+            gs[thread].addmv_(J.t(), r.slice(0, start, start + J.size(0)));
+            Ds[thread] += (J * J).sum(0);
+        });
+    g = reduce(gs);
+    D = reduce(Ds);
+}
+
+}
+
+// Solve A x = b by Jacobi preconditioned conjugate gradient,
+// where A is only available as matrix-vector product
+// Stop once p^T.A.p is no longer positive (round-off or a nearly singular A), keeping the current x
+at::Tensor conjugate_gradient(const std::function<at::Tensor(const at::Tensor &)> & A,
+const at::Tensor & b, const at::Tensor & diagA,
+const size_t & max_iteration, const double & tolerance) {
+    at::Tensor x = b.new_zeros(b.sizes());
+    at::Tensor r = b.clone();
+    double threshold = tolerance * b.norm().item<double>();
+    // b = 0 included
+    if (r.norm().item<double>() <= threshold) return x;
+    at::Tensor z = r / diagA;
+    at::Tensor p = z.clone();
+    double rz = r.dot(z).item<double>();
+    for (size_t iteration = 0; iteration < max_iteration; iteration++) {
+        at::Tensor Ap = A(p);
+        double pAp = p.dot(Ap).item<double>();
+        if (pAp <= 0.0) break;
+        double alpha = rz / pAp;
+        x += alpha * p;
+        r -= alpha * Ap;
+        if (r.norm().item<double>() < threshold) break;
+        z = r / diagA;
+        double rz_new = r.dot(z).item<double>();
+        p = z + (rz_new / rz) * p;
+        rz = rz_new;
+    }
+    return x;
+}
+
+// Train without ever forming the Jacobian:
+// each Jacobian block is consumed right after its data point is evaluated, once per Levenberg-Marquardt iteration,
+// then the step is solved by conjugate gradient on JᵀJ products by forward and reverse mode
+void optimize_matrix_free(const size_t & max_iteration, const size_t & max_CG_iteration) {
+    int32_t NEqs, NPars;
+    std::tie(NEqs, NPars) = count_eq_par();
+
+    at::Tensor c = regularization.new_empty(NPars);
+    p2c(c.data_ptr<double>());
+    at::Tensor r = c.new_empty(NEqs);
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The initial residue = " << r.norm().item<double>() << std::endl;
+
+    at::Tensor reg_square = regularization * regularization;
+    // the parameters where J and JᵀJ are evaluated
+    at::Tensor c_linear;
+    auto linearize = [&](const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D) {
+        data_gradient(c, r, g, D);
+        g += reg_square * (c - prior);
+        D += reg_square;
+        c_linear = c.clone();
+    };
+    auto solve = [&](const at::Tensor & g, const at::Tensor & D, const double & mu) {
+        auto A = [&](const at::Tensor & v) {
+            return JTJv(c_linear.data_ptr<double>(), c_linear.size(0), v) + (reg_square + mu * D) * v;
+        };
+        return conjugate_gradient(A, -g, (1.0 + mu) * D, max_CG_iteration, 1e-3);
+    };
+    Levenberg_Marquardt(residue, regularization, prior, linearize, solve, c, NEqs, max_iteration);
+    c2p(c.data_ptr<double>());
+
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The final residue = " << r.norm().item<double>() << '\n';
+}
+
+} // namespace trust_region
+} // namespace train
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <omp.h>
+
+#include <functional>
+
+#include "common.hpp"
+#include "Levenberg_Marquardt.hpp"
+
+namespace train { namespace trust_region {
+
+std::tuple<int32_t, int32_t> count_eq_par();
+
+void residue(double * r, const double * c, const int32_t & M, const int32_t & N);
+
+void Jacobian_blocks(const double * c, const int32_t & N,
+const std::function<void(const size_t & thread, const at::Tensor & J, const size_t & start)> & f);
+
+namespace {
+
+// The upper triangle of JᵀJ accumulated in place from the Jacobian blocks of all threads
+// Each thread buffers up to `buffer_rows` rows, then adds their Gram matrix tile by tile,
+// where each tile of the upper triangle has its own lock and the threads start from different tiles,
+// so the memory is NPars^2 + threads x buffer_rows x NPars rather than a JᵀJ per thread
+class UpperGram {
+    private:
+        const int64_t tile_ = 256, buffer_rows_ = 256;
+
+        at::Tensor JTJ_;
+        // the (row, column) tiles of the upper triangle
+        std::vector<std::pair<int64_t, int64_t>> tiles_;
+        std::vector<omp_lock_t> locks_;
+        std::vector<at::Tensor> buffers_;
+        std::vector<int64_t> counts_;
+
+        // JTJ_ += Bᵀ B over the upper triangle tiles
+        void add_(const size_t & thread, const at::Tensor & B) {
+            int64_t NPars = JTJ_.size(0);
+            size_t offset = thread * tiles_.size() / buffers_.size();
+            for (size_t k = 0; k < tiles_.size(); k++) {
+                size_t index = (k + offset) % tiles_.size();
+                int64_t row = tiles_[index].first * tile_, column = tiles_[index].second * tile_;
+                int64_t rows = std::min(tile_, NPars - row), columns = std::min(tile_, NPars - column);
+                omp_set_lock(&locks_[index]);
+                JTJ_.narrow(0, row, rows).narrow(1, column, columns)
+                    .addmm_(B.narrow(1, row, rows).t(), B.narrow(1, column, columns));
+                omp_unset_lock(&locks_[index]);
+            }
+        }
+    public:
+        // `JTJ` is NPars x NPars, zeroed here
+        UpperGram(const at::Tensor & JTJ, const size_t & NThreads) : JTJ_(JTJ) {
+            JTJ_.zero_();
+            int64_t NTiles = (JTJ_.size(0) + tile_ - 1) / tile_;
+            for (int64_t column = 0; column < NTiles; column++)
+            for (int64_t row = 0; row <= column; row++)
+            tiles_.push_back({row, column});
+            locks_.resize(tiles_.size());
+            for (omp_lock_t & lock : locks_) omp_init_lock(&lock);
+            buffers_.resize(NThreads);
+            counts_.assign(NThreads, 0);
+        }
+        ~UpperGram() {for (omp_lock_t & lock : locks_) omp_destroy_lock(&lock);}
+
+        // add the rows J of `thread`
+        void add(const size_t & thread, const at::Tensor & J) {
+            int64_t rows = J.size(0);
+            if (rows >= buffer_rows_) {
+                add_(thread, J);
+                return;
+            }
+            if (! buffers_[thread].defined()) buffers_[thread] = J.new_empty({buffer_rows_, J.size(1)});
+            if (counts_[thread] + rows > buffer_rows_) {
+                add_(thread, buffers_[thread].narrow(0, 0, counts_[thread]));
+                counts_[thread] = 0;
+            }
+            buffers_[thread].narrow(0, counts_[thread], rows).copy_(J);
+            counts_[thread] += rows;
+        }
+        // add the rows left in the buffers, outside parallel regions
+        void flush() {
+            for (size_t thread = 0; thread < buffers_.size(); thread++)
+            if (counts_[thread] > 0) {
+                add_(thread, buffers_[thread].narrow(0, 0, counts_[thread]));
+                counts_[thread] = 0;
+            }
+        }
+};
+
+// the upper triangle of JᵀJ and Jᵀr of the data rows, streamed point by point
+// JᵀJ is accumulated in place, Jᵀr by each thread then reduced
+void normal_equations(const at::Tensor & c, const at::Tensor & r, at::Tensor & JTJ, at::Tensor & JTr) {
+    int64_t NPars = c.size(0);
+    UpperGram gram(JTJ, OMP_NUM_THREADS);
+    std::vector<at::Tensor> JTrs(OMP_NUM_THREADS);
+    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) JTrs[thread] = c.new_zeros(NPars);
+    Jacobian_blocks(c.data_ptr<double>(), NPars,
+        [&](const size_t & thread, const at::Tensor & J, const size_t & start) {
+            gram.add(thread, J);
+            JTrs[thread].addmv_(J.t(), r.slice(0, start, start + J.size(0)));
+        });
+    gram.flush();
+    JTr = JTrs[0];
+    for (size_t thread = 1; thread < OMP_NUM_THREADS; thread++) JTr += JTrs[thread];
+}
+
+}
+
+// Train with the normal equations accumulated on the fly,
+// so the memory scales as NPars^2 rather than NEqs x NPars
+void optimize_normal_equations(const size_t & max_iteration) {
+    int32_t NEqs, NPars;
+    std::tie(NEqs, NPars) = count_eq_par();
+
+    at::Tensor c = regularization.new_empty(NPars);
+    p2c(c.data_ptr<double>());
+    at::Tensor r = c.new_empty(NEqs);
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The initial residue = " << r.norm().item<double>() << std::endl;
+
+    at::Tensor reg_square = regularization * regularization;
+    // only the upper triangle is meaningful
+    at::Tensor JTJ = c.new_empty({NPars, NPars});
+    auto linearize = [&](const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D) {
+        normal_equations(c, r, JTJ, g);
+        // the regularization rows only add to the diagonal
+        JTJ.diagonal().add_(reg_square);
+        g += reg_square * (c - prior);
+        D = JTJ.diagonal().clone();
+    };
+    auto solve = [&](const at::Tensor & g, const at::Tensor & D, const double & mu) {
+        // damp the diagonal of JᵀJ in place rather than copying it, then restore
+        at::Tensor diagonal = JTJ.diagonal().clone();
+        JTJ.diagonal().add_(mu * D);
+        at::Tensor U;
+        try {
+            U = at::cholesky(JTJ, true);
+        }
+        catch (const std::exception &) {}
+        JTJ.diagonal().copy_(diagonal);
+        // numerically singular at this damping, let Levenberg-Marquardt raise μ
+        if (! U.defined()) return at::Tensor();
+        return at::cholesky_solve(-g.unsqueeze(-1), U, true).squeeze(-1);
+    };
+    Levenberg_Marquardt(residue, regularization, prior, linearize, solve, c, NEqs, max_iteration);
+    c2p(c.data_ptr<double>());
+
+    residue(r.data_ptr<double>(), c.data_ptr<double>(), NEqs, NPars);
+    std::cout << "The final residue = " << r.norm().item<double>() << '\n';
+}
+
+} // namespace trust_region
+} // namespace train
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include <functional>
+
+#include <Hderiva/basic.hpp>
+
+#include "ordering.hpp"
+
+namespace train {
+
+namespace {
+
+// Hungarian algorithm (with potentials) for the square assignment problem,
+// return the column assigned to each row minimizing the total cost
+std::vector<int64_t> Hungarian(const std::vector<std::vector<double>> & cost) {
+    size_t n = cost.size();
+    // 1-based, row 0 and column 0 are sentinels
+    std::vector<double> u(n + 1, 0.0), v(n + 1, 0.0);
+    std::vector<size_t> p(n + 1, 0), way(n + 1, 0);
+    for (size_t i = 1; i <= n; i++) {
+        p[0] = i;
+        size_t j0 = 0;
+        std::vector<double> minv(n + 1, INFINITY);
+        std::vector<bool> used(n + 1, false);
+        do {
+            used[j0] = true;
+            size_t i0 = p[j0], j1 = 0;
+            double delta = INFINITY;
+            for (size_t j = 1; j <= n; j++)
+            if (! used[j]) {
+                double cur = cost[i0 - 1][j - 1] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+            for (size_t j = 0; j <= n; j++)
+            if (used[j]) {
+                u[p[j]] += delta;
+                v[j] -= delta;
+            }
+            else minv[j] -= delta;
+            j0 = j1;
+        } while (p[j0] != 0);
+        do {
+            size_t j1 = way[j0];
+            p[j0] = p[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    std::vector<int64_t> assignment(n);
+    for (size_t j = 1; j <= n; j++) assignment[p[j] - 1] = j - 1;
+    return assignment;
+}
+
+// Maximize sum_{i < j} phase_i phase_j w[i][j] over phase_i = ±1 with phase_0 = +1 by branch and bound,
+// starting from the greedy incumbent of single flips
+// Return the maximum, `phase` is the maximizer on output
+double max_phase(const std::vector<std::vector<double>> & w, std::vector<int64_t> & phase) {
+    size_t n = w.size();
+    phase.assign(n, 1);
+    if (n < 2) return 0.0;
+    auto value = [&](const std::vector<int64_t> & s) -> double {
+        double result = 0.0;
+        for (size_t i = 0; i < n; i++)
+        for (size_t j = i + 1; j < n; j++)
+        result += s[i] * s[j] * w[i][j];
+        return result;
+    };
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (size_t k = 1; k < n; k++) {
+            double gain = 0.0;
+            for (size_t j = 0; j < n; j++) if (j != k) gain -= 2.0 * phase[k] * phase[j] * (k < j ? w[k][j] : w[j][k]);
+            if (gain > 1e-15) {
+                phase[k] = -phase[k];
+                improved = true;
+            }
+        }
+    }
+    double best = value(phase);
+    // rest[k] = sum_{j >= k, i < j} |w[i][j]|, the most the undecided phases k, k + 1, ... can add
+    std::vector<double> rest(n + 1, 0.0);
+    for (size_t k = n - 1; k > 0; k--) {
+        rest[k] = rest[k + 1];
+        for (size_t i = 0; i < k; i++) rest[k] += std::abs(w[i][k]);
+    }
+    std::vector<int64_t> s(n, 1);
+    std::function<void(const size_t &, const double &)> branch = [&](const size_t & k, const double & current) {
+        if (k == n) {
+            if (current > best) {
+                best = current;
+                phase = s;
+            }
+            return;
+        }
+        if (current + rest[k] <= best) return;
+        for (const int64_t & sign : {1, -1}) {
+            s[k] = sign;
+            double increment = 0.0;
+            for (size_t i = 0; i < k; i++) increment += s[i] * sign * w[i][k];
+            branch(k + 1, current + increment);
+        }
+    };
+    branch(1, 0.0);
+    return best;
+}
+
+}
+
+// The cost of a permutation p and phases s is
+//     sum_i || A[p_i][p_i] - A_data[i][i] ||^2 + sum_{i < j} || s_i s_j A[p_i][p_j] - A_data[i][j] ||^2,
+// whose relaxation taking the best sign of each pair independently is a lower bound,
+// so the permutations are searched by branch and bound with the relaxed cost as the bound,
+// and the phases of each complete permutation by `max_phase`
+// The Hungarian assignment of the diagonal and `warm` are the starting incumbents
+Ordering order_states(const at::Tensor & A, const at::Tensor & A_data, const Ordering & warm) {
+    int64_t N = A.size(0), N_data = A_data.size(0);
+    if (N_data > N) throw std::invalid_argument(
+    "train::order_states: A_data must not have more states than A");
+    at::Tensor A_full      = Hderiva::fill_lower_triangle(A     .reshape({N     , N     , -1}));
+    at::Tensor A_data_full = Hderiva::fill_lower_triangle(A_data.reshape({N_data, N_data, -1}));
+    // diagonal[i][k] = || A[k][k] - A_data[i][i] ||^2
+    at::Tensor diagonal = (A_data_full.diagonal(0, 0, 1).t().unsqueeze(1)
+                         - A_full.diagonal(0, 0, 1).t().unsqueeze(0)).pow(2).sum(-1);
+    // norm2[k][l] = || A[k][l] ||^2, data_norm2[i][j] = || A_data[i][j] ||^2, dots[i][j][k][l] = A_data[i][j] . A[k][l]
+    at::Tensor norm2 = A_full.pow(2).sum(-1),
+               data_norm2 = A_data_full.pow(2).sum(-1);
+    at::Tensor dots = at::einsum("ijx,klx->ijkl", {A_data_full, A_full});
+    auto diagonal_ = diagonal.accessor<double, 2>();
+    auto norm2_ = norm2.accessor<double, 2>();
+    auto data_norm2_ = data_norm2.accessor<double, 2>();
+    auto dots_ = dots.accessor<double, 4>();
+    // the relaxed cost of pair ij assigned to kl, nonnegative
+    auto pair = [&](const int64_t & i, const int64_t & j, const int64_t & k, const int64_t & l) -> double {
+        return norm2_[k][l] + data_norm2_[i][j] - 2.0 * std::abs(dots_[i][j][k][l]);
+    };
+    // the exact cost of the first N_data states of a permutation, as well as the best phases
+    auto exact_cost = [&](const std::vector<int64_t> & p, std::vector<int64_t> & phase) -> double {
+        double result = 0.0, sum_abs = 0.0;
+        std::vector<std::vector<double>> w(N_data, std::vector<double>(N_data, 0.0));
+        for (int64_t i = 0; i < N_data; i++) {
+            result += diagonal_[i][p[i]];
+            for (int64_t j = i + 1; j < N_data; j++) {
+                result += pair(i, j, p[i], p[j]);
+                w[i][j] = dots_[i][j][p[i]][p[j]];
+                sum_abs += std::abs(w[i][j]);
+            }
+        }
+        return result + 2.0 * (sum_abs - max_phase(w, phase));
+    };
+    // only the first N_data states are compared, break ties by them lexicographically
+    auto better = [&](const double & cost, const std::vector<int64_t> & p,
+                      const double & best, const std::vector<int64_t> & best_p) -> bool {
+        double tolerance = 1e-12 * std::max(1.0, best);
+        if (cost < best - tolerance) return true;
+        if (cost > best + tolerance) return false;
+        return std::lexicographical_compare(p.begin(), p.begin() + N_data, best_p.begin(), best_p.begin() + N_data);
+    };
+    // starting incumbents, where the states beyond A_data are free in the assignment
+    std::vector<std::vector<double>> cost(N, std::vector<double>(N, 0.0));
+    for (int64_t i = 0; i < N_data; i++)
+    for (int64_t k = 0; k < N; k++)
+    cost[i][k] = diagonal_[i][k];
+    std::vector<int64_t> best_p = Hungarian(cost), best_phase;
+    double best = exact_cost(best_p, best_phase);
+    if ((int64_t)warm.permutation.size() == N) {
+        std::vector<int64_t> warm_phase;
+        double warm_cost = exact_cost(warm.permutation, warm_phase);
+        if (better(warm_cost, warm.permutation, best, best_p)) {
+            best_p = warm.permutation;
+            best_phase = warm_phase;
+            best = warm_cost;
+        }
+    }
+    // branch and bound over the model state assigned to each data state
+    std::vector<int64_t> p(N, 0);
+    std::vector<bool> used(N, false);
+    std::function<void(const int64_t &, const double &)> branch = [&](const int64_t & i, const double & relaxed) {
+        if (i == N_data) {
+            std::vector<int64_t> phase;
+            double exact = exact_cost(p, phase);
+            if (better(exact, p, best, best_p)) {
+                best_p = p;
+                best_phase = phase;
+                best = exact;
+            }
+            return;
+        }
+        double bound = relaxed;
+        for (int64_t r = i; r < N_data; r++) {
+            double least = INFINITY;
+            for (int64_t k = 0; k < N; k++) if (! used[k]) least = std::min(least, diagonal_[r][k]);
+            bound += least;
+        }
+        if (bound > best + 1e-12 * std::max(1.0, best)) return;
+        for (int64_t k = 0; k < N; k++)
+        if (! used[k]) {
+            double increment = diagonal_[i][k];
+            for (int64_t j = 0; j < i; j++) increment += pair(j, i, p[j], k);
+            p[i] = k;
+            used[k] = true;
+            branch(i + 1, relaxed + increment);
+            used[k] = false;
+        }
+    };
+    branch(0, 0.0);
+    // the states beyond A_data take the unused ones in ascending order and keep their phases
+    Ordering ordering;
+    ordering.permutation.assign(best_p.begin(), best_p.begin() + N_data);
+    std::vector<bool> taken(N, false);
+    for (const int64_t & k : ordering.permutation) taken[k] = true;
+    for (int64_t k = 0; k < N; k++) if (! taken[k]) ordering.permutation.push_back(k);
+    ordering.phase.assign(N, 1);
+    for (int64_t i = 0; i < N_data; i++) ordering.phase[i] = best_phase[i];
+    return ordering;
+}
+
+// new state i = old state ordering.permutation[i] * ordering.phase[i]
+void alter_(at::Tensor & eigval, at::Tensor & eigvec, const Ordering & ordering) {
+    at::Tensor permutation = at::tensor(ordering.permutation, at::TensorOptions().dtype(torch::kInt64));
+    at::Tensor phase = at::tensor(ordering.phase, at::TensorOptions().dtype(torch::kInt64)).to(eigvec.dtype());
+    eigval = eigval.index_select(0, permutation);
+    eigvec = eigvec.index_select(1, permutation) * phase;
+}
+
+} // namespace train
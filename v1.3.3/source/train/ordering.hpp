@@ -0,0 +1,24 @@
+#ifndef train_ordering_hpp
+#define train_ordering_hpp
+
+#include <torch/torch.h>
+
+namespace train {
+
+// The ordering of eigenstates: new state i is old state permutation[i] multiplied by phase[i] = ±1
+struct Ordering {
+    std::vector<int64_t> permutation, phase;
+};
+
+// Return the ordering of A minimizing || ordered A - A_data ||^2 over the "upper triangle" of A_data,
+// where A (A_data) is N x N x K (N_data x N_data x K) with only the "upper triangle" meaningful
+// The search is exact, among equally good orderings the lexicographically smallest permutation is returned
+// `warm` (e.g. the choice at the previous parameters) only speeds up the search, may be empty
+Ordering order_states(const at::Tensor & A, const at::Tensor & A_data, const Ordering & warm = Ordering());
+
+// new state i = old state ordering.permutation[i] * ordering.phase[i]
+void alter_(at::Tensor & eigval, at::Tensor & eigvec, const Ordering & ordering);
+
+} // namespace train
+
+#endif
\ No newline at end of file
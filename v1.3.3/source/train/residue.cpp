@@ -1,35 +1,24 @@
 #include <tchem/linalg.hpp>
 
-#include <Hderiva/diabatic.hpp>
-
 #include "common.hpp"
 
 namespace train { namespace trust_region {
 
 inline void reg_residue(const size_t & thread, const std::shared_ptr<RegHam> & data,
-double * r, size_t & start) {
+const size_t & key, Memo & memo, double * r, size_t & start) {
+    torch::NoGradGuard no_grad;
     // get necessary diabatic quantities
-    CL::utility::matrix<at::Tensor> x1s = data->x1s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x1s[i][j].set_requires_grad(true);
-    at::Tensor   Hd1 = Hdnet1s[thread]->forward(x1s);
-    at::Tensor DrHd1 = Hderiva::DxHd(Hd1, x1s, data->Jx1rTs());
-    CL::utility::matrix<at::Tensor> x2s = data->x2s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x2s[i][j].set_requires_grad(true);
-    at::Tensor   Hd2 = Hdnet2s[thread]->forward(x2s);
-    at::Tensor DrHd2 = Hderiva::DxHd(Hd2, x2s, data->Jx2rTs());
-    // stop autograd tracking
-    Hd1.detach_();
-    Hd2.detach_();
+    at::Tensor Hd1, DrHd1, Hd2, DrHd2;
+    std::tie(Hd1, DrHd1) = Hdnet1s[thread]->forward_Jacobian(data->x1s(), data->Jx1rTs());
+    std::tie(Hd2, DrHd2) = Hdnet2s[thread]->forward_Jacobian(data->x2s(), data->Jx2rTs());
     // combine both Hd networks
     at::Tensor   Hd =   Hd1 +   Hd2;
     at::Tensor DrHd = DrHd1 + DrHd2;
     // get adiabatic representation
     at::Tensor energy, states;
-    std::tie(energy, states) = define_adiabatz(Hd, DrHd, data->NStates(), data->dH());
+    std::tie(energy, states) = memoize(memo, key, [&]() {
+        return define_adiabatz(Hd, DrHd, data->dH(), memo.ordering);
+    });
     // make prediction in adiabatic representation
     int64_t NStates_data = data->NStates();
     energy = energy.slice(0, 0, NStates_data);
@@ -54,29 +43,20 @@ double * r, size_t & start) {
 }
 
 inline void deg_residue(const size_t & thread, const std::shared_ptr<DegHam> & data,
-double * r, size_t & start) {
+const size_t & key, Memo & memo, double * r, size_t & start) {
+    torch::NoGradGuard no_grad;
     // get necessary diabatic quantities
-    CL::utility::matrix<at::Tensor> x1s = data->x1s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x1s[i][j].set_requires_grad(true);
-    at::Tensor   Hd1 = Hdnet1s[thread]->forward(x1s);
-    at::Tensor DrHd1 = Hderiva::DxHd(Hd1, x1s, data->Jx1rTs());
-    CL::utility::matrix<at::Tensor> x2s = data->x2s();
-    for (size_t i = 0; i < NStates; i++)
-    for (size_t j = i; j < NStates; j++)
-    x2s[i][j].set_requires_grad(true);
-    at::Tensor   Hd2 = Hdnet2s[thread]->forward(x2s);
-    at::Tensor DrHd2 = Hderiva::DxHd(Hd2, x2s, data->Jx2rTs());
-    // stop autograd tracking
-    Hd1.detach_();
-    Hd2.detach_();
+    at::Tensor Hd1, DrHd1, Hd2, DrHd2;
+    std::tie(Hd1, DrHd1) = Hdnet1s[thread]->forward_Jacobian(data->x1s(), data->Jx1rTs());
+    std::tie(Hd2, DrHd2) = Hdnet2s[thread]->forward_Jacobian(data->x2s(), data->Jx2rTs());
     // combine both Hd networks
     at::Tensor   Hd =   Hd1 +   Hd2;
     at::Tensor DrHd = DrHd1 + DrHd2;
     // get composite representation
     at::Tensor eigval, eigvec;
-    std::tie(eigval, eigvec) = define_composite(Hd, DrHd, data->H(), data->dH());
+    std::tie(eigval, eigvec) = memoize(memo, key, [&]() {
+        return define_composite(Hd, DrHd, data->H(), data->dH(), memo.ordering);
+    });
     // make prediction in composite representation
     at::Tensor   Hc = tchem::linalg::UT_sy_U(  Hd, eigvec);
     at::Tensor DrHc = tchem::linalg::UT_sy_U(DrHd, eigvec);
@@ -124,29 +104,23 @@ double * r, size_t & start) {
 }
 
 void residue(double * r, const double * c, const int32_t & M, const int32_t & N) {
+    size_t key = parameters_key(c, N);
+    c2p(c);
     #pragma omp parallel for
     for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
-        c2p(c, thread);
-        size_t start = segstart[thread];
-        for (const auto & data : regchunk[thread]) reg_residue(thread, data, r, start);
-        for (const auto & data : degchunk[thread]) deg_residue(thread, data, r, start);
-        for (const auto & data : energy_chunk[thread]) energy_residue(thread, data, r, start);
-    }
-}
-
-void regularized_residue(double * r, const double * c, const int32_t & M, const int32_t & N) {
-    #pragma omp parallel for
-    for (size_t thread = 0; thread < OMP_NUM_THREADS; thread++) {
-        c2p(c, thread);
-        size_t start = segstart[thread];
-        for (const auto & data : regchunk[thread]) reg_residue(thread, data, r, start);
-        for (const auto & data : degchunk[thread]) deg_residue(thread, data, r, start);
-        for (const auto & data : energy_chunk[thread]) energy_residue(thread, data, r, start);
+        for (size_t i = 0; i < regchunk[thread].size(); i++) {
+            size_t start = regrows[thread][i];
+            reg_residue(thread, regchunk[thread][i], key, regmemos[thread][i], r, start);
+        }
+        for (size_t i = 0; i < degchunk[thread].size(); i++) {
+            size_t start = degrows[thread][i];
+            deg_residue(thread, degchunk[thread][i], key, degmemos[thread][i], r, start);
+        }
+        for (size_t i = 0; i < energy_chunk[thread].size(); i++) {
+            size_t start = energy_rows[thread][i];
+            energy_residue(thread, energy_chunk[thread][i], r, start);
+        }
     }
-    c10::TensorOptions top = c10::TensorOptions().dtype(torch::kFloat64);
-    at::Tensor residue = at::from_blob(r, M, top),
-               p       = at::from_blob(const_cast<double *>(c), N, top);
-    residue.slice(0, M - N, M).copy_(regularization * (p - prior));
 }
 
 } // namespace trust_region
@@ -0,0 +1,163 @@
+#include <numeric>
+#include <random>
+
+#include <Foptim/least-square/trust_region.hpp>
+
+#include <tchem/linalg.hpp>
+#include <tchem/chemistry.hpp>
+
+#include "../source/train/ordering.hpp"
+#include "../source/train/Levenberg_Marquardt.hpp"
+
+// || A - B ||^2 over the "upper triangle"
+double distance2(const at::Tensor & A, const at::Tensor & B) {
+    double result = 0.0;
+    for (int64_t i = 0; i < A.size(0); i++)
+    for (int64_t j = i; j < A.size(1); j++)
+    result += (A[i][j] - B[i][j]).pow(2).sum().item<double>();
+    return result;
+}
+
+void test_ordering() {
+    c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
+    int64_t dim = 3;
+    double unit = 2.0;
+    std::mt19937 generator(0);
+    double difference_adiabatz = 0.0, difference_composite = 0.0, difference_warm = 0.0;
+    for (int64_t N = 2; N <= 4; N++) {
+        tchem::chem::Orderer orderer(N);
+        for (size_t repeat = 0; repeat < 20; repeat++) {
+            at::Tensor   Hd = at::rand({N, N}, top),
+                       DrHd = at::rand({N, N, dim}, top);
+            at::Tensor eigval, eigvec;
+            std::tie(eigval, eigvec) = (Hd + Hd.t()).symeig(true);
+            at::Tensor   H_data = at::rand({N, N}, top),
+                       dH_data = at::rand({N, N, dim}, top);
+
+            // adiabatic representation
+            at::Tensor DrHa = tchem::linalg::UT_sy_U(DrHd, eigvec);
+            size_t ipermutation, iphase;
+            std::tie(ipermutation, iphase) = orderer.ipermutation_iphase_min(DrHa, dH_data);
+            at::Tensor energy_tchem = eigval.clone(), states_tchem = eigvec.clone();
+            orderer.alter_eigvals_(energy_tchem, ipermutation);
+            orderer.alter_states_(states_tchem, ipermutation, N, iphase);
+            train::Ordering ordering = train::order_states(DrHa, dH_data);
+            at::Tensor energy = eigval.clone(), states = eigvec.clone();
+            train::alter_(energy, states, ordering);
+            difference_adiabatz += std::abs(
+                distance2(tchem::linalg::UT_sy_U(DrHd, states_tchem), dH_data)
+              - distance2(tchem::linalg::UT_sy_U(DrHd, states      ), dH_data));
+
+            // the result must not depend on the warm start
+            train::Ordering warm;
+            warm.permutation.resize(N);
+            std::iota(warm.permutation.begin(), warm.permutation.end(), 0);
+            std::shuffle(warm.permutation.begin(), warm.permutation.end(), generator);
+            warm.phase.assign(N, -1);
+            train::Ordering ordering_warm = train::order_states(DrHa, dH_data, warm);
+            for (int64_t i = 0; i < N; i++) {
+                difference_warm += std::abs(ordering_warm.permutation[i] - ordering.permutation[i]);
+                difference_warm += std::abs(ordering_warm.phase[i] - ordering.phase[i]);
+            }
+
+            // composite representation
+            at::Tensor   Hc = tchem::linalg::UT_sy_U(  Hd, eigvec),
+                       DrHc = tchem::linalg::UT_sy_U(DrHd, eigvec);
+            std::tie(ipermutation, iphase) = orderer.ipermutation_iphase_min(Hc, DrHc, H_data, dH_data, unit * unit);
+            at::Tensor eigval_tchem = eigval.clone(), eigvec_tchem = eigvec.clone();
+            orderer.alter_eigvals_(eigval_tchem, ipermutation);
+            orderer.alter_states_(eigvec_tchem, ipermutation, N, iphase);
+            ordering = train::order_states(at::cat({unit * Hc.unsqueeze(-1), DrHc}, -1),
+                                           at::cat({unit * H_data.unsqueeze(-1), dH_data}, -1));
+            at::Tensor eigval_train = eigval.clone(), eigvec_train = eigvec.clone();
+            train::alter_(eigval_train, eigvec_train, ordering);
+            difference_composite += std::abs(
+                unit * unit * distance2(tchem::linalg::UT_sy_U(Hd, eigvec_tchem), H_data)
+              + distance2(tchem::linalg::UT_sy_U(DrHd, eigvec_tchem), dH_data)
+              - unit * unit * distance2(tchem::linalg::UT_sy_U(Hd, eigvec_train), H_data)
+              - distance2(tchem::linalg::UT_sy_U(DrHd, eigvec_train), dH_data));
+        }
+    }
+    std::cout << "Ordering in adiabatic representation against tchem::chem::Orderer, should print close to 0:\n"
+              << difference_adiabatz << '\n'
+              << "\nOrdering in composite representation against tchem::chem::Orderer, should print close to 0:\n"
+              << difference_composite << '\n'
+              << "\nDependence on the warm start, should print 0:\n"
+              << difference_warm << '\n';
+}
+
+// fit y = c0 exp(c1 t) + c2 to data it cannot reproduce exactly,
+// regularized towards a prior, so that the regularization shifts the minimizer
+namespace fit {
+
+const int32_t M = 12, N = 3;
+
+at::Tensor t, y, regularization, prior;
+
+void residue(double * r, const double * c, const int32_t & M, const int32_t & N) {
+    at::Tensor r_ = at::from_blob(r, M, t.options());
+    r_.copy_(c[0] * at::exp(c[1] * t) + c[2] - y);
+}
+
+// J in column-major order, i.e. Jᵀ in row-major order
+void Jacobian(double * JT, const double * c, const int32_t & M, const int32_t & N) {
+    at::Tensor JT_ = at::from_blob(JT, {N, M}, t.options());
+    at::Tensor e = at::exp(c[1] * t);
+    JT_[0].copy_(e);
+    JT_[1].copy_(c[0] * t * e);
+    JT_[2].fill_(1.0);
+}
+
+// the regularization appended as residue rows, for Foptim
+void residue_regularized(double * r, const double * c, const int32_t & M_reg, const int32_t & N) {
+    residue(r, c, M, N);
+    at::Tensor c_ = at::from_blob(const_cast<double *>(c), N, t.options());
+    at::from_blob(r + M, N, t.options()).copy_(regularization * (c_ - prior));
+}
+void Jacobian_regularized(double * JT, const double * c, const int32_t & M_reg, const int32_t & N) {
+    at::Tensor JT_ = at::from_blob(JT, {N, M_reg}, t.options());
+    at::Tensor JT_data = t.new_empty({N, M});
+    Jacobian(JT_data.data_ptr<double>(), c, M, N);
+    JT_.slice(1, 0, M).copy_(JT_data);
+    JT_.slice(1, M).copy_(regularization.diag());
+}
+
+}
+
+void test_Levenberg_Marquardt() {
+    c10::TensorOptions top = at::TensorOptions().dtype(torch::kFloat64);
+    fit::t = at::linspace(0.0, 1.0, fit::M, top);
+    fit::y = 2.0 * at::exp(-1.5 * fit::t) + 0.3 * at::sin(5.0 * fit::t);
+    fit::regularization = at::full(fit::N, 0.3, top);
+    fit::prior = at::tensor({1.0, -1.0, 0.0}, top);
+    at::Tensor init = at::tensor({1.0, 0.0, 0.0}, top);
+
+    at::Tensor c_Foptim = init.clone();
+    Foptim::trust_region(fit::residue_regularized, fit::Jacobian_regularized,
+                         c_Foptim.data_ptr<double>(), fit::M + fit::N, fit::N,
+                         100, 100, 1e-12, 1e-15);
+
+    at::Tensor c = init.clone();
+    at::Tensor reg_square = fit::regularization * fit::regularization;
+    at::Tensor JT = c.new_empty({fit::N, fit::M}), JTJ;
+    auto linearize = [&](const at::Tensor & c, const at::Tensor & r, at::Tensor & g, at::Tensor & D) {
+        fit::Jacobian(JT.data_ptr<double>(), c.data_ptr<double>(), fit::M, fit::N);
+        JTJ = JT.mm(JT.t());
+        g = JT.mv(r) + reg_square * (c - fit::prior);
+        D = JTJ.diag() + reg_square;
+    };
+    auto solve = [&](const at::Tensor & g, const at::Tensor & D, const double & mu) {
+        at::Tensor L = (JTJ + (reg_square + mu * D).diag()).cholesky();
+        return at::cholesky_solve(-g.unsqueeze(-1), L).squeeze(-1);
+    };
+    train::trust_region::Levenberg_Marquardt(fit::residue, fit::regularization, fit::prior,
+        linearize, solve, c, fit::M, 100, 1e-14, 1e-14);
+
+    std::cout << "\nRegularized Levenberg-Marquardt against Foptim::trust_region, should print close to 0:\n"
+              << (c - c_Foptim).norm().item<double>() << '\n';
+}
+
+int main() {
+    test_ordering();
+    test_Levenberg_Marquardt();
+}
\ No newline at end of file